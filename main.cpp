@@ -12,7 +12,11 @@ int main(int argc, char **argv) {
     }
 
     config_generator generator = config_generator(parameters);
-    generator.run();
+    bool run_success = generator.run();
+
+    if (!run_success) {
+        return -1;
+    }
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,303 @@
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include "archive_writer.h"
+
+#ifdef CONFIG_GENERATOR_ZLIB
+#include <zlib.h>
+#endif
+
+const size_t
+        BLOCK_SIZE = 512,
+        WRITE_CHUNK_SIZE = 1 << 20,
+        NAME_SIZE = 100,
+        PREFIX_SIZE = 155;
+
+const char
+        TYPE_FILE = '0',
+        TYPE_DIRECTORY = '5',
+        TYPE_GNU_LONG_NAME = 'L';
+
+/*
+ * Fastest gzip level, output size matters less than render time.
+ */
+const int COMPRESSION_LEVEL = 1;
+
+/*
+ * Write number as zero padded octal, terminated with null character, into field of given size.
+ */
+static void write_octal(char *field, size_t field_size, uint64_t number) {
+
+    for (size_t i = field_size - 1; i > 0; i--) {
+        field[i - 1] = static_cast<char>('0' + (number & 7));
+        number >>= 3;
+    }
+
+    field[field_size - 1] = '\0';
+}
+
+/*
+ * Remove leading slashes, archives only contain relative paths.
+ */
+static std::string_view relative_entry_name(std::string_view path) {
+
+    while (!path.empty() && path.front() == '/') {
+        path.remove_prefix(1);
+    }
+
+    return path;
+}
+
+bool archive_writer::supports_compression() {
+#ifdef CONFIG_GENERATOR_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+archive_writer::~archive_writer() {
+    try {
+        this->close();
+    }
+    catch (std::runtime_error &) {
+        // destructor can't report errors, close explicitly to get them
+    }
+}
+
+bool archive_writer::is_open() const {
+    return this->file_descriptor >= 0;
+}
+
+/*
+ * Create archive file, replacing existing one.
+ * Throws runtime_error if file can't be created or compression isn't supported.
+ */
+void archive_writer::open(const std::string &path, bool compressed_archive) {
+
+    if (compressed_archive && !archive_writer::supports_compression()) {
+        throw std::runtime_error("Compressed archives are not supported, config-generator was built without zlib.");
+    }
+
+    this->file_descriptor = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+    if (this->file_descriptor < 0) {
+        std::ostringstream error_stream;
+        error_stream << "Can't create archive " << path << ": " << strerror(errno) << ".";
+        throw std::runtime_error(error_stream.str());
+    }
+
+    this->archive_path = path;
+    this->modification_time = time(nullptr);
+    this->compress = compressed_archive;
+    this->pending.reserve(WRITE_CHUNK_SIZE + BLOCK_SIZE);
+
+#ifdef CONFIG_GENERATOR_ZLIB
+    if (this->compress) {
+        auto *stream = new z_stream();
+
+        // 16 + window bits writes gzip instead of raw zlib format
+        deflateInit2(stream, COMPRESSION_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+
+        this->compression_stream = stream;
+    }
+#endif
+}
+
+/*
+ * Add header block for entry. Names that don't fit into ustar name and prefix fields
+ * are written into a GNU long name entry in front of the header.
+ */
+void archive_writer::add_header(std::string_view entry_name, char type, uint64_t size) {
+
+    char header[BLOCK_SIZE];
+    std::memset(header, 0, BLOCK_SIZE);
+
+    std::string_view name = entry_name, prefix;
+
+    if (name.size() > NAME_SIZE) {
+
+        // split at slash, so that prefix and name both fit into their fields
+        size_t separator = name.rfind('/', PREFIX_SIZE);
+
+        if (separator != std::string_view::npos && name.size() - separator - 1 <= NAME_SIZE && separator > 0) {
+            prefix = name.substr(0, separator);
+            name = name.substr(separator + 1);
+        } else {
+            this->add_header("././@LongLink", TYPE_GNU_LONG_NAME, entry_name.size() + 1);
+            this->pending.append(entry_name.data(), entry_name.size());
+            this->pending.push_back('\0');
+            this->add_padding(entry_name.size() + 1);
+
+            name = entry_name.substr(0, NAME_SIZE);
+        }
+    }
+
+    std::memcpy(header, name.data(), name.size());
+    write_octal(header + 100, 8, type == TYPE_DIRECTORY ? 0755 : 0644);
+    write_octal(header + 108, 8, 0);
+    write_octal(header + 116, 8, 0);
+    write_octal(header + 124, 12, size);
+    write_octal(header + 136, 12, static_cast<uint64_t>(this->modification_time));
+    header[156] = type;
+    std::memcpy(header + 257, "ustar", 6);
+    std::memcpy(header + 263, "00", 2);
+    std::memcpy(header + 345, prefix.data(), prefix.size());
+
+    // checksum is computed with checksum field filled with spaces
+    std::memset(header + 148, ' ', 8);
+
+    unsigned int checksum = 0;
+    for (char character : header) {
+        checksum += static_cast<unsigned char>(character);
+    }
+
+    write_octal(header + 148, 7, checksum);
+    header[155] = ' ';
+
+    this->pending.append(header, BLOCK_SIZE);
+}
+
+/*
+ * Pad entry contents of given size to whole block.
+ */
+void archive_writer::add_padding(uint64_t size) {
+
+    size_t remainder = size % BLOCK_SIZE;
+
+    if (remainder != 0) {
+        this->pending.append(BLOCK_SIZE - remainder, '\0');
+    }
+
+    if (this->pending.size() >= WRITE_CHUNK_SIZE) {
+        this->write_pending(false);
+    }
+}
+
+/*
+ * Add directory entry, once for every directory.
+ */
+void archive_writer::add_directory(const std::string &path) {
+
+    std::string entry_name(relative_entry_name(path));
+
+    while (!entry_name.empty() && entry_name.back() == '/') {
+        entry_name.pop_back();
+    }
+
+    if (entry_name.empty() || !this->directories.insert(entry_name).second) return;
+
+    entry_name.push_back('/');
+
+    this->add_header(entry_name, TYPE_DIRECTORY, 0);
+}
+
+void archive_writer::add_file(const std::string &path, std::string_view contents) {
+
+    this->add_header(relative_entry_name(path), TYPE_FILE, contents.size());
+    this->pending.append(contents.data(), contents.size());
+    this->add_padding(contents.size());
+}
+
+/*
+ * Write all bytes to archive file.
+ * Throws runtime_error if writing fails.
+ */
+void archive_writer::write_bytes(const char *bytes, size_t size) {
+
+    while (size > 0) {
+
+        ssize_t written = ::write(this->file_descriptor, bytes, size);
+
+        if (written < 0) {
+            if (errno == EINTR) continue;
+
+            std::ostringstream error_stream;
+            error_stream << "Can't write archive " << this->archive_path << ": " << strerror(errno) << ".";
+            throw std::runtime_error(error_stream.str());
+        }
+
+        bytes += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+/*
+ * Write pending entries to file, compressing them first if needed.
+ * finish ends compressed stream.
+ */
+void archive_writer::write_pending(bool finish) {
+
+#ifdef CONFIG_GENERATOR_ZLIB
+    if (this->compress) {
+
+        auto *stream = static_cast<z_stream *>(this->compression_stream);
+
+        stream->next_in = reinterpret_cast<Bytef *>(&this->pending[0]);
+        stream->avail_in = static_cast<uInt>(this->pending.size());
+
+        this->compressed.resize(WRITE_CHUNK_SIZE);
+
+        int result;
+
+        do {
+            stream->next_out = reinterpret_cast<Bytef *>(&this->compressed[0]);
+            stream->avail_out = static_cast<uInt>(this->compressed.size());
+
+            result = deflate(stream, finish ? Z_FINISH : Z_NO_FLUSH);
+
+            this->write_bytes(this->compressed.data(), this->compressed.size() - stream->avail_out);
+
+        } while (stream->avail_out == 0 || (finish && result != Z_STREAM_END));
+
+        this->pending.clear();
+        return;
+    }
+#endif
+
+    this->write_bytes(this->pending.data(), this->pending.size());
+    this->pending.clear();
+}
+
+/*
+ * Write end of archive and close file.
+ * Throws runtime_error if writing fails.
+ */
+void archive_writer::close() {
+
+    if (!this->is_open()) return;
+
+    // archive ends with two empty blocks
+    this->pending.append(2 * BLOCK_SIZE, '\0');
+
+    try {
+        this->write_pending(true);
+    }
+    catch (std::runtime_error &) {
+        this->release();
+        throw;
+    }
+
+    this->release();
+}
+
+/*
+ * Free compression stream and close file, without writing anything.
+ */
+void archive_writer::release() {
+
+#ifdef CONFIG_GENERATOR_ZLIB
+    if (this->compression_stream != nullptr) {
+        auto *stream = static_cast<z_stream *>(this->compression_stream);
+        deflateEnd(stream);
+        delete stream;
+        this->compression_stream = nullptr;
+    }
+#endif
+
+    ::close(this->file_descriptor);
+    this->file_descriptor = -1;
+}
@@ -0,0 +1,62 @@
+#ifndef CONFIG_GENERATOR_ARCHIVE_WRITER_H
+#define CONFIG_GENERATOR_ARCHIVE_WRITER_H
+
+#include <cstdint>
+#include <ctime>
+#include <set>
+#include <string>
+#include <string_view>
+
+/*
+ * Writes files and directories into a single tar archive (ustar, with GNU long names),
+ * optionally gzip compressed.
+ * Entries are collected in memory and written in large sequential chunks,
+ * so adding a file doesn't cost any system calls of its own.
+ */
+class archive_writer {
+
+private:
+    int file_descriptor = -1;
+    std::string archive_path;
+    std::string pending;
+    std::set<std::string> directories;
+    time_t modification_time = 0;
+
+    bool compress = false;
+    void *compression_stream = nullptr;
+    std::string compressed;
+
+    void add_header(std::string_view entry_name, char type, uint64_t size);
+
+    void add_padding(uint64_t size);
+
+    void write_pending(bool finish);
+
+    void write_bytes(const char *bytes, size_t size);
+
+    void release();
+
+public:
+    static bool supports_compression();
+
+    archive_writer() = default;
+
+    archive_writer(const archive_writer &) = delete;
+
+    archive_writer &operator=(const archive_writer &) = delete;
+
+    ~archive_writer();
+
+    bool is_open() const;
+
+    void open(const std::string &path, bool compressed_archive);
+
+    void add_directory(const std::string &path);
+
+    void add_file(const std::string &path, std::string_view contents);
+
+    void close();
+};
+
+
+#endif //CONFIG_GENERATOR_ARCHIVE_WRITER_H
@@ -0,0 +1,448 @@
+#include <sstream>
+#include <algorithm>
+#include <functional>
+#include "compiled_template.h"
+#include "string_utils.h"
+#include "parsing_utils.h"
+
+// power of two, so that slots are found with a mask
+const size_t VARIABLE_TABLE_MIN_SIZE = 16;
+
+void compiled_template::clear() {
+    this->text.clear();
+    this->lines.clear();
+    this->segments.clear();
+    this->variables.clear();
+    this->errors.clear();
+    this->conditions.clear();
+    this->folded_text.clear();
+    this->variable_table.assign(VARIABLE_TABLE_MIN_SIZE, NO_VARIABLE);
+    this->open_loops.clear();
+}
+
+std::string_view compiled_template::segment_text(const template_segment &segment) const {
+    return std::string_view(this->text).substr(segment.offset, segment.length);
+}
+
+std::string_view compiled_template::operand_text(const template_operand &operand) const {
+    return std::string_view(this->text).substr(operand.offset, operand.length);
+}
+
+std::string_view compiled_template::operand_folded_text(const template_operand &operand) const {
+    return std::string_view(this->folded_text).substr(operand.folded_offset, operand.length);
+}
+
+namespace {
+
+    /*
+     * Definer known at compile time, for the common single character definers.
+     */
+    template<char DEFINER>
+    struct char_definer {
+
+        static constexpr char VALUE[] = {DEFINER, '\0'};
+
+        explicit char_definer(std::string_view) {}
+
+        static constexpr std::string_view value() { return std::string_view(VALUE, 1); }
+
+        static constexpr size_t size() { return 1; }
+
+        static size_t find(std::string_view line, size_t position) { return line.find(DEFINER, position); }
+    };
+
+    /*
+     * Definer of any length, known only at runtime.
+     */
+    struct string_definer {
+
+        std::string_view definer;
+
+        explicit string_definer(std::string_view definer) : definer(definer) {}
+
+        std::string_view value() const { return this->definer; }
+
+        size_t size() const { return this->definer.size(); }
+
+        size_t find(std::string_view line, size_t position) const { return line.find(this->definer, position); }
+    };
+
+    /*
+     * Put index of variable into the first empty slot of its hash in compiled.variable_table.
+     */
+    void insert_variable_slot(compiled_template &compiled, std::string_view name, int32_t variable) {
+
+        size_t mask = compiled.variable_table.size() - 1;
+        size_t slot = std::hash<std::string_view>()(name) & mask;
+
+        while (compiled.variable_table[slot] != compiled_template::NO_VARIABLE) {
+            slot = (slot + 1) & mask;
+        }
+
+        compiled.variable_table[slot] = variable;
+    }
+
+    /*
+     * Return index of variable name in compiled.variables, adding it if it isn't there yet.
+     * Names are looked up in compiled.variable_table, which is kept at most half full.
+     */
+    int32_t add_variable(compiled_template &compiled, uint32_t offset, uint32_t length) {
+
+        std::string_view name = std::string_view(compiled.text).substr(offset, length);
+
+        size_t mask = compiled.variable_table.size() - 1;
+
+        for (size_t slot = std::hash<std::string_view>()(name) & mask;
+             compiled.variable_table[slot] != compiled_template::NO_VARIABLE; slot = (slot + 1) & mask) {
+
+            int32_t variable = compiled.variable_table[slot];
+
+            if (compiled.segment_text(compiled.variables[variable]) == name) {
+                return variable;
+            }
+        }
+
+        auto variable = static_cast<int32_t>(compiled.variables.size());
+        compiled.variables.push_back({offset, length, compiled_template::NO_VARIABLE});
+
+        if (compiled.variables.size() * 2 <= compiled.variable_table.size()) {
+            insert_variable_slot(compiled, name, variable);
+            return variable;
+        }
+
+        // table is reused between compiles, so it only allocates when it grows past its largest size
+        compiled.variable_table.assign(compiled.variable_table.size() * 2, compiled_template::NO_VARIABLE);
+
+        for (size_t i = 0; i < compiled.variables.size(); i++) {
+            insert_variable_slot(compiled, compiled.segment_text(compiled.variables[i]), static_cast<int32_t>(i));
+        }
+
+        return variable;
+    }
+
+    void add_error(compiled_template &compiled, template_line &line, const std::string &error) {
+        line.kind = template_line_kind::ERROR;
+        line.error = static_cast<uint32_t>(compiled.errors.size());
+        compiled.errors.push_back(error);
+    }
+
+    /*
+     * Compile word of if statement (text between offsets word_start and word_end) into operand.
+     * Returns false if word is neither literal text nor exactly one variable.
+     */
+    bool compile_operand(compiled_template &compiled, size_t definer_size, const template_line &compiled_line,
+                         uint32_t word_start, uint32_t word_end, template_operand &operand) {
+
+        operand = {word_start, word_end - word_start, 0, compiled_template::NO_VARIABLE};
+
+        for (uint32_t i = compiled_line.first_segment;
+             i < compiled_line.first_segment + compiled_line.segment_count; i++) {
+
+            const template_segment &segment = compiled.segments[i];
+
+            if (segment.variable == compiled_template::NO_VARIABLE) continue;
+
+            // whole variable, from definer to closing curly brace
+            uint32_t variable_start = segment.offset - static_cast<uint32_t>(definer_size) - 1;
+            uint32_t variable_end = segment.offset + segment.length + 1;
+
+            if (variable_end <= word_start || variable_start >= word_end) continue;
+
+            if (variable_start != word_start || variable_end != word_end) return false;
+
+            operand.variable = segment.variable;
+        }
+
+        if (operand.variable == compiled_template::NO_VARIABLE) {
+            operand.folded_offset = static_cast<uint32_t>(compiled.folded_text.size());
+
+            for (char character : compiled.operand_text(operand)) {
+                compiled.folded_text.push_back(string_utils::fold_ascii_char(character));
+            }
+        }
+
+        return true;
+    }
+
+    /*
+     * Compile if statement (trimmed, starting at line_offset in text) into conditions, so that
+     * evaluating it needs no substitution and word splitting, and literals are case folded only once.
+     * Lines that can't be compiled (syntax errors, variables inside of words) get no conditions
+     * and are evaluated from substituted text, which also reports their errors.
+     */
+    void compile_conditions(compiled_template &compiled, size_t definer_size, std::string_view line,
+                            uint32_t line_offset, template_line &compiled_line) {
+
+        const int WORDS_IN_IF_SUBCONDITION = 4;
+
+        size_t first_condition = compiled.conditions.size();
+        size_t folded_text_size = compiled.folded_text.size();
+
+        size_t position = 0;
+        size_t word_count = std::count(line.begin(), line.end(), ' ') + 1;
+
+        bool compiled_successfully = word_count % WORDS_IN_IF_SUBCONDITION == 0;
+
+        for (size_t i = 0; compiled_successfully && i < word_count / WORDS_IN_IF_SUBCONDITION; i++) {
+
+            uint32_t word_starts[WORDS_IN_IF_SUBCONDITION], word_ends[WORDS_IN_IF_SUBCONDITION];
+            std::string_view words[WORDS_IN_IF_SUBCONDITION];
+
+            for (int w = 0; w < WORDS_IN_IF_SUBCONDITION; w++) {
+                word_starts[w] = static_cast<uint32_t>(line_offset + position);
+                words[w] = parsing_utils::next_word(line, position);
+                word_ends[w] = word_starts[w] + static_cast<uint32_t>(words[w].size());
+            }
+
+            template_condition condition{};
+
+            // first subcondition starts with IF word instead of logical operator
+            if (i == 0) {
+                condition.logical_operator = template_logical_operator::NONE;
+            } else if (words[0] == parsing_utils::LOGICAL_AND) {
+                condition.logical_operator = template_logical_operator::AND;
+            } else if (words[0] == parsing_utils::LOGICAL_OR) {
+                condition.logical_operator = template_logical_operator::OR;
+            } else {
+                compiled_successfully = false;
+                break;
+            }
+
+            if (words[2] == parsing_utils::CONDITIONAL_IS) {
+                condition.is_not = false;
+            } else if (words[2] == parsing_utils::CONDITIONAL_IS_NOT) {
+                condition.is_not = true;
+            } else {
+                compiled_successfully = false;
+                break;
+            }
+
+            compiled_successfully =
+                    compile_operand(compiled, definer_size, compiled_line, word_starts[1], word_ends[1],
+                                    condition.left) &&
+                    compile_operand(compiled, definer_size, compiled_line, word_starts[3], word_ends[3],
+                                    condition.right);
+
+            compiled.conditions.push_back(condition);
+        }
+
+        if (!compiled_successfully) {
+            compiled.conditions.resize(first_condition);
+            compiled.folded_text.resize(folded_text_size);
+            return;
+        }
+
+        compiled_line.first_condition = static_cast<uint32_t>(first_condition);
+        compiled_line.condition_count = static_cast<uint32_t>(compiled.conditions.size() - first_condition);
+    }
+
+    /*
+     * Split line into literal and variable segments and decide what kind of line it is.
+     * line_offset is position of line in compiled.text.
+     */
+    template<typename DEFINER_TYPE>
+    void compile_line(compiled_template &compiled, const DEFINER_TYPE &definer, std::string_view line,
+                      uint32_t line_offset, template_line &compiled_line) {
+
+        compiled_line.kind = template_line_kind::TEXT;
+        compiled_line.first_segment = static_cast<uint32_t>(compiled.segments.size());
+
+        bool has_empty_variable = false;
+        size_t position = 0;
+
+        while (position < line.size()) {
+
+            // find beginning of variable with given pattern %{...}
+            size_t variable_start = definer.find(line, position);
+
+            while (variable_start != std::string_view::npos &&
+                   (variable_start + definer.size() >= line.size() || line[variable_start + definer.size()] != '{')) {
+                variable_start = definer.find(line, variable_start + 1);
+            }
+
+            if (variable_start == std::string_view::npos) break;
+
+            size_t name_start = variable_start + definer.size() + 1;
+            size_t name_end = line.find('}', name_start);
+
+            // unterminated variable is kept as is
+            if (name_end == std::string_view::npos) break;
+
+            if (variable_start > position) {
+                compiled.segments.push_back({static_cast<uint32_t>(line_offset + position),
+                                             static_cast<uint32_t>(variable_start - position),
+                                             compiled_template::NO_VARIABLE});
+            }
+
+            if (name_end == name_start) {
+                has_empty_variable = true;
+            } else {
+                uint32_t name_offset = static_cast<uint32_t>(line_offset + name_start);
+                uint32_t name_length = static_cast<uint32_t>(name_end - name_start);
+
+                compiled.segments.push_back({name_offset, name_length,
+                                             add_variable(compiled, name_offset, name_length)});
+            }
+
+            position = name_end + 1;
+        }
+
+        if (position < line.size()) {
+            compiled.segments.push_back({static_cast<uint32_t>(line_offset + position),
+                                         static_cast<uint32_t>(line.size() - position),
+                                         compiled_template::NO_VARIABLE});
+        }
+
+        compiled_line.segment_count = static_cast<uint32_t>(compiled.segments.size()) - compiled_line.first_segment;
+
+        if (has_empty_variable) {
+            add_error(compiled, compiled_line, "Empty variable.");
+            return;
+        }
+
+        std::string_view trimmed_line = string_utils::trim_view(line);
+        std::string_view loop_variable, list_variable;
+
+        // for statements are matched with endfor statements once the whole template is compiled
+        try {
+            if (parsing_utils::is_line_for_statement(trimmed_line, definer.value(), loop_variable, list_variable)) {
+
+                compiled_line.kind = template_line_kind::FOR;
+                compiled_line.loop_variable = add_variable(compiled,
+                                                           static_cast<uint32_t>(loop_variable.data() -
+                                                                                 compiled.text.data()),
+                                                           static_cast<uint32_t>(loop_variable.size()));
+
+                for (uint32_t i = compiled_line.first_segment; i < compiled.segments.size(); i++) {
+                    if (compiled.segments[i].variable != compiled_template::NO_VARIABLE) {
+                        compiled_line.list_variable = compiled.segments[i].variable;
+                    }
+                }
+
+                return;
+            }
+
+            if (parsing_utils::is_line_endfor_statement(trimmed_line, definer.value())) {
+                compiled_line.kind = template_line_kind::ENDFOR;
+                return;
+            }
+        }
+        catch (std::runtime_error &error) {
+            add_error(compiled, compiled_line, error.what());
+            return;
+        }
+
+        std::string_view include_path;
+
+        // malformed include, if and endif statements are kept as error lines and reported when rendered
+        try {
+            if (parsing_utils::is_line_include_statement(trimmed_line, definer.value(), include_path)) {
+
+                // included file is found when template is compiled, so its path can't depend on variables
+                for (uint32_t i = compiled_line.first_segment; i < compiled.segments.size(); i++) {
+                    if (compiled.segments[i].variable != compiled_template::NO_VARIABLE) {
+                        add_error(compiled, compiled_line, "Include path can't contain variables.");
+                        return;
+                    }
+                }
+
+                compiled_line.kind = template_line_kind::INCLUDE;
+
+                compiled.segments.resize(compiled_line.first_segment);
+                compiled.segments.push_back({static_cast<uint32_t>(line_offset + (include_path.data() - line.data())),
+                                             static_cast<uint32_t>(include_path.size()),
+                                             compiled_template::NO_VARIABLE});
+                compiled_line.segment_count = 1;
+
+            } else if (parsing_utils::is_line_if_statement(trimmed_line, definer.value())) {
+
+                compiled_line.kind = template_line_kind::IF;
+
+                compile_conditions(compiled, definer.size(), trimmed_line,
+                                   static_cast<uint32_t>(line_offset + (trimmed_line.data() - line.data())),
+                                   compiled_line);
+
+            } else if (parsing_utils::is_line_endif_statement(trimmed_line, definer.value())) {
+                compiled_line.kind = template_line_kind::ENDIF;
+            }
+        }
+        catch (std::runtime_error &error) {
+            add_error(compiled, compiled_line, error.what());
+        }
+    }
+
+    /*
+     * Compile kernel: split template into lines and compile every line.
+     */
+    template<typename DEFINER_TYPE>
+    void compile(std::string_view template_source, std::string_view definer_value, compiled_template &compiled) {
+
+        DEFINER_TYPE definer(definer_value);
+
+        compiled.clear();
+        compiled.text.assign(template_source.data(), template_source.size());
+
+        std::string_view text = compiled.text;
+
+        size_t line_start = 0;
+        int line_number = 1;
+
+        while (line_start < text.size()) {
+
+            size_t line_end = text.find('\n', line_start);
+
+            if (line_end == std::string_view::npos) {
+                line_end = text.size();
+            }
+
+            std::string_view line = text.substr(line_start, line_end - line_start);
+
+            template_line compiled_line{template_line_kind::EMPTY, line_number, 0, 0, 0, 0, 0, 0, 0, 0};
+
+            // ignore empty lines
+            // todo: keep whitespace in empty lines?
+            if (!string_utils::trim_view(line).empty()) {
+                compile_line(compiled, definer, line, static_cast<uint32_t>(line_start), compiled_line);
+            }
+
+            auto line_index = static_cast<uint32_t>(compiled.lines.size());
+
+            if (compiled_line.kind == template_line_kind::FOR) {
+                compiled.open_loops.push_back(line_index);
+            } else if (compiled_line.kind == template_line_kind::ENDFOR) {
+
+                if (compiled.open_loops.empty()) {
+                    add_error(compiled, compiled_line, "No endfor expected here.");
+                } else {
+                    compiled_line.matching_line = compiled.open_loops.back();
+                    compiled.lines[compiled.open_loops.back()].matching_line = line_index;
+                    compiled.open_loops.pop_back();
+                }
+            }
+
+            compiled.lines.push_back(compiled_line);
+
+            line_start = line_end + 1;
+            line_number++;
+        }
+
+        for (uint32_t line_index : compiled.open_loops) {
+            add_error(compiled, compiled.lines[line_index],
+                      "Expected endfor (check if every for statement has a corresponding endfor)");
+        }
+    }
+}
+
+/*
+ * Pick compile kernel for definer once, so that compiling doesn't check definer per line.
+ * Common definers get their own kernel, others use generic one.
+ */
+compiled_template::compile_kernel compiled_template::select_compile_kernel(const std::string &definer) {
+
+    if (definer == "%") return &compile<char_definer<'%'>>;
+    if (definer == "#") return &compile<char_definer<'#'>>;
+    if (definer == "$") return &compile<char_definer<'$'>>;
+    if (definer == "@") return &compile<char_definer<'@'>>;
+
+    return &compile<string_definer>;
+}
@@ -0,0 +1,136 @@
+#ifndef CONFIG_GENERATOR_COMPILED_TEMPLATE_H
+#define CONFIG_GENERATOR_COMPILED_TEMPLATE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Kind of template line, decided once when template is compiled.
+ */
+enum class template_line_kind : uint8_t {
+    EMPTY,
+    TEXT,
+    IF,
+    ENDIF,
+    INCLUDE,
+    FOR,
+    ENDFOR,
+    ERROR
+};
+
+/*
+ * Part of template line: either literal text or a variable (%{...}).
+ */
+struct template_segment {
+    uint32_t offset;
+    uint32_t length;
+
+    // index into compiled_template::variables, or NO_VARIABLE for literal text
+    int32_t variable;
+};
+
+/*
+ * Value in if statement condition: literal text or exactly one variable.
+ */
+struct template_operand {
+    uint32_t offset;
+    uint32_t length;
+
+    // offset of case folded literal in compiled_template::folded_text
+    uint32_t folded_offset;
+
+    // index into compiled_template::variables, or NO_VARIABLE for literal text
+    int32_t variable;
+};
+
+enum class template_logical_operator : uint8_t {
+    NONE,
+    AND,
+    OR
+};
+
+/*
+ * One sub condition of if statement, such as AND A IS B.
+ */
+struct template_condition {
+    template_logical_operator logical_operator;
+    bool is_not;
+    template_operand left;
+    template_operand right;
+};
+
+struct template_line {
+    template_line_kind kind;
+    int line_number;
+
+    // segments of line; INCLUDE lines have one segment, path of included file
+    uint32_t first_segment;
+    uint32_t segment_count;
+
+    // index into compiled_template::errors for ERROR lines
+    uint32_t error;
+
+    // conditions of IF lines; IF lines without conditions are evaluated from substituted text
+    uint32_t first_condition;
+    uint32_t condition_count;
+
+    // FOR lines: variable that takes each item and list variable, both indexes into compiled_template::variables
+    int32_t loop_variable;
+    int32_t list_variable;
+
+    // FOR lines: index of matching ENDFOR line, ENDFOR lines: index of matching FOR line
+    uint32_t matching_line;
+};
+
+/*
+ * Template split into lines and segments, so that rendering doesn't have to look for
+ * variables and statements again.
+ * All data is kept in flat vectors that point into a copy of template text, so that compiling
+ * into the same compiled_template again reuses its capacity.
+ */
+class compiled_template {
+
+public:
+    static constexpr int32_t NO_VARIABLE = -1;
+
+    /*
+     * Compile function, specialized for one definer.
+     */
+    typedef void (*compile_kernel)(std::string_view template_source, std::string_view definer,
+                                   compiled_template &compiled);
+
+    std::string text;
+    std::vector<template_line> lines;
+    std::vector<template_segment> segments;
+
+    // unique variable names used in template, as segments of text
+    std::vector<template_segment> variables;
+
+    // if statement conditions, with literals case folded into folded_text
+    std::vector<template_condition> conditions;
+    std::string folded_text;
+
+    // syntax errors, found while compiling, thrown when their line is rendered
+    std::vector<std::string> errors;
+
+    // compile scratch: open addressing hash table of indexes into variables, NO_VARIABLE in empty slots
+    std::vector<int32_t> variable_table;
+
+    // compile scratch: indexes of for statement lines that haven't ended yet
+    std::vector<uint32_t> open_loops;
+
+    void clear();
+
+    std::string_view segment_text(const template_segment &segment) const;
+
+    std::string_view operand_text(const template_operand &operand) const;
+
+    std::string_view operand_folded_text(const template_operand &operand) const;
+
+    static compile_kernel select_compile_kernel(const std::string &definer);
+};
+
+
+#endif //CONFIG_GENERATOR_COMPILED_TEMPLATE_H
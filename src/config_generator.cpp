@@ -5,196 +5,308 @@
 #include <fstream>
 #include <iostream>
 #include <sstream>
-#include <stack>
+#include <cstring>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <set>
 #include "config_generator.h"
 #include "string_utils.h"
 #include "parsing_utils.h"
+#include "shard_utils.h"
+#include "thread_utils.h"
+#include "file_utils.h"
+#include "template_checker.h"
+#include "env_index.h"
 #include <unistd.h>
 #include <sys/types.h>
 #include <dirent.h>
 #include <sys/stat.h>
 
-config_generator::config_generator(generator_parameters &parameters) : parameters(&parameters) {}
+config_generator::config_generator(generator_parameters &parameters)
+        : parameters(&parameters),
+          env_var_dictionary(parameters.definer),
+          partials(parameters.definer),
+          renderer(parameters.definer, parameters.is_case_sensitive, this->env_var_dictionary, this->partials) {
+
+    this->log.configure(parameters.logging_level, parameters.logging_format);
+}
 
 /*
- * Read one specific environment file into the class dictionary.
- * Overrides overlapping variables in previous environment files.
- * Skips file if env file doesn't exist.
+ * Recursively collect paths of all files in directory, relative to it.
+ * Returns false if directory, or any directory in it, can't be opened.
  */
-void config_generator::read_env_file(const std::string &file_path) {
-
-    std::ifstream env_file(file_path);
+static bool collect_directory_files(const std::string &directory_path, const std::string &relative_path,
+                                    std::vector<std::string> &file_names) {
 
-    if (!env_file.good()) {
-        std::cerr << "[WARN] Environment file " << file_path << " doesn't exist, skipping." << std::endl;
-        return;
-    }
+    DIR *dir;
+    struct dirent *entry;
+    bool is_complete = true;
 
-    std::string line;
-    int line_count = 1;
-    while (std::getline(env_file, line)) {
+    if (!(dir = opendir(directory_path.c_str())))
+        return false;
 
-        std::string trimmed_line = string_utils::trim(line);
+    while ((entry = readdir(dir)) != NULL) {
 
-        // ignore empty lines
-        if (trimmed_line.length() == 0) continue;
+        // ignore . and ..
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
 
-        std::pair<std::string, std::string> name_value_pair;
+        std::string entry_relative_path = relative_path.empty() ? entry->d_name : relative_path + "/" + entry->d_name;
 
-        try {
-            name_value_pair = parsing_utils::get_name_value_pair(trimmed_line, '=');
+        if (entry->d_type == DT_DIR) {
+            is_complete = collect_directory_files(directory_path + "/" + entry->d_name, entry_relative_path,
+                                                  file_names) && is_complete;
+        } else {
+            file_names.push_back(entry_relative_path);
         }
-        catch (std::runtime_error &error) {
+    }
 
-            // print error, but continue
-            std::cerr << "[ERROR] File: " << file_path << ", line: " << line_count << ": " << error.what() << std::endl;
-            continue;
-        }
+    closedir(dir);
 
-        // check if value already exists and display override warning if it does
-        if (this->env_var_dictionary.find(name_value_pair.first) != this->env_var_dictionary.end()) {
-            std::cout << "[WARN] File: " << file_path << ", line: " << line_count << ": overriding value of variable '"
-                      << name_value_pair.first << "' from " << this->env_var_dictionary[name_value_pair.first] << " to "
-                      << name_value_pair.second << std::endl;
-        }
+    return is_complete;
+}
 
-        this->env_var_dictionary[name_value_pair.first] = name_value_pair.second;
+/*
+ * Create output directory, or add it to archive if output goes to archive.
+ */
+void config_generator::make_output_directory(const std::string &directory_path) {
 
-        line_count++;
+    if (this->archive.is_open()) {
+        this->make_output_directories(directory_path);
+        return;
     }
 
-    env_file.close();
+    mkdir(directory_path.c_str(), 0777);
 }
 
 /*
- * Iterate env files list and read them into env_var_dictionary.
+ * Create output directory with all of its missing parent directories.
  */
-void config_generator::read_env_files() {
+void config_generator::make_output_directories(const std::string &directory_path) {
+
+    for (size_t separator = directory_path.find('/', 1); separator != std::string::npos;
+         separator = directory_path.find('/', separator + 1)) {
 
-    for (const auto &environment_file : this->parameters->environment_files) {
-        this->read_env_file(environment_file);
+        if (this->archive.is_open()) {
+            this->archive.add_directory(directory_path.substr(0, separator));
+        } else {
+            mkdir(directory_path.substr(0, separator).c_str(), 0777);
+        }
+    }
+
+    if (this->archive.is_open()) {
+        this->archive.add_directory(directory_path);
+    } else {
+        mkdir(directory_path.c_str(), 0777);
     }
 }
 
 /*
- * Read one specific template file and perform configuration generation.
- * At the end, write it to output and to stdout, if specified.
+ * Write generated_file to output file, or add it to archive if output goes to archive.
  */
-void config_generator::generate_file(const std::string &file_path, const std::string &out_file_path) {
-
-    std::ostringstream generated_file_stream;
-
-    std::ifstream template_file(file_path);
+void config_generator::write_output_file(const std::string &out_file_path) {
 
-    if (!template_file.good()) {
-        std::cout << "[WARN] Template file" << file_path << "doesn't exist, skipping." << std::endl;
+    if (this->archive.is_open()) {
+        this->archive.add_file(out_file_path, this->generated_file.view());
         return;
     }
 
-    std::string line;
-    int line_count = 1;
+    std::ofstream output_file(out_file_path, std::ios::binary);
+    this->generated_file.write_to(output_file);
+    output_file.close();
+}
 
-    /*
-     * To support nested if statements, stack is introduced.
-     * When we enter if statement, the evaluation is pushed on stack.
-     * If we enter another if statement, the evaluation is again pushed on stack.
-     * When we reach endif, value is popped and next evaluation is taken for previous if statement (if it exists)
-     */
-    std::stack<bool> if_statement_evaluations_stack;
+/*
+ * Merge one already read environment file into the class dictionary.
+ * Overrides overlapping variables in previous environment files.
+ * Skips file if env file doesn't exist.
+ */
+void config_generator::merge_env_file(const env_file &file) {
 
-    while (std::getline(template_file, line)) {
+    if (!file.exists) {
+        this->log.warn("Environment file ", file.file_path, " doesn't exist, skipping.");
+        return;
+    }
+
+    for (const auto &line : file.lines) {
 
-        std::string trimmed_line = string_utils::trim(line);
+        if (!line.error.empty()) {
 
-        // ignore empty lines
-        // todo: keep whitespace in empty lines?
-        if (trimmed_line.length() == 0) {
-            generated_file_stream << std::endl;
+            // print error, but continue
+            this->log.error("File: ", file.file_path, ", line: ", line.line_count, ": ", line.error);
             continue;
         }
 
-        try {
+        // check if value already exists and display override warning if it does
+        // value is shown as written, since derived values can't be evaluated before all files are linked
+        const env_value *variable = this->env_var_dictionary.find_evaluated(line.name);
 
-            // first, substitute everything in the file
-            // this will also substitute variables in if statements
-            // this line is not trimmed, so that indents are kept
-            std::string substituted_line = parsing_utils::substitute_vars(line, this->parameters->definer,
-                                                                          this->env_var_dictionary);
+        if (variable != nullptr) {
+            this->log.warn("File: ", file.file_path, ", line: ", line.line_count, ": overriding value of variable '",
+                           line.name, "' from ", variable->value, " to ", line.value.value);
+        }
 
-            // trim this line now, to use it for further analysis
-            std::string substituted_line_trimmed = string_utils::trim(substituted_line);
+        this->env_var_dictionary.define(line.name, line.value, file.file_path, line.line_count);
+    }
+}
 
-            if (parsing_utils::is_line_if_statement(substituted_line_trimmed, this->parameters->definer)) {
-                // is line if?
+/*
+ * Derived values of lazily read variables reference variables that templates don't use directly,
+ * so read those as well, until values don't reference any new variables.
+ * Lines are kept in file order, so that precedence and warnings don't depend on when variable was read.
+ */
+void config_generator::read_derived_references(std::vector<env_file> &files,
+                                               const std::vector<std::unique_ptr<env_index>> &file_indexes,
+                                               const std::vector<std::string> &referenced_variables) {
 
-                // evaluate it
-                bool if_statement_evaluated = parsing_utils::evaluate_if_statement_line(substituted_line_trimmed,
-                                                                                        this->parameters->definer,
-                                                                                        this->parameters->is_case_sensitive);
+    std::set<std::string> read_variables(referenced_variables.begin(), referenced_variables.end());
+    std::vector<size_t> checked_lines(files.size(), 0);
 
-                // put it on stack
-                if_statement_evaluations_stack.push(if_statement_evaluated);
+    bool has_read_references = false;
 
-            } else if (parsing_utils::is_line_endif_statement(substituted_line_trimmed, this->parameters->definer)) {
-                // is line endif?
+    while (true) {
 
-                // if no other if statements have been introduced prior, this is an error
-                if (if_statement_evaluations_stack.empty()) {
+        std::vector<std::string> new_variables;
 
-                    throw std::runtime_error("No endif expected here.");
+        for (unsigned long i = 0; i < files.size(); i++) {
+
+            for (size_t l = checked_lines[i]; l < files[i].lines.size(); l++) {
+                for (auto &reference : this->env_var_dictionary.references(files[i].lines[l].value.value)) {
+                    if (read_variables.insert(reference).second) {
+                        new_variables.push_back(std::move(reference));
+                    }
                 }
+            }
 
-                // take away the current if value, because the block has ended here
-                if_statement_evaluations_stack.pop();
+            checked_lines[i] = files[i].lines.size();
+        }
 
-            } else {
-                // is normal line?
+        if (new_variables.empty()) break;
 
-                // check if there is currently an if statement active
-                if (!if_statement_evaluations_stack.empty()) {
+        // files without index were read whole, so they already contain every variable
+        for (unsigned long i = 0; i < files.size(); i++) {
+            if (file_indexes[i]) {
+                file_indexes[i]->resolve(new_variables, files[i]);
+            }
+        }
 
-                    // check if currently activated if statement is evaluated as true
-                    if (if_statement_evaluations_stack.top()) {
+        has_read_references = true;
+    }
 
-                        // if yes, add it to file. Otherwise don't.
-                        generated_file_stream << substituted_line << std::endl;
-                    }
-                } else {
+    if (has_read_references) {
+        for (auto &file : files) {
+            std::stable_sort(file.lines.begin(), file.lines.end(),
+                             [](const env_file_line &a, const env_file_line &b) {
+                                 return a.line_count < b.line_count;
+                             });
+        }
+    }
+}
 
-                    // no if statement, add normally to the file
-                    generated_file_stream << substituted_line << std::endl;
-                }
-            }
+/*
+ * Read all env files concurrently, then merge them into env_var_dictionary in the order they were given,
+ * so that precedence and warnings are the same as if they were read one after another.
+ */
+void config_generator::read_env_files() {
+
+    const std::vector<std::string> &environment_files = this->parameters->environment_files;
+    const std::string &env_cache_directory = this->parameters->env_cache_directory;
+
+    std::vector<env_file> files(environment_files.size());
+
+    // lazy environment only reads variables that templates use, so templates are analysed first
+    std::vector<std::string> referenced_variables;
+    std::vector<std::unique_ptr<env_index>> file_indexes(environment_files.size());
+
+    if (this->parameters->lazy_env) {
+        this->build_index();
+        referenced_variables = this->index.variables();
+    }
 
-            line_count++;
+    auto read_env_file = [&](unsigned long i) {
+
+        if (!this->parameters->lazy_env) {
+            files[i].read(environment_files[i]);
+            return;
+        }
+
+        try {
+            auto file_index = std::make_unique<env_index>();
+
+            files[i].file_path = environment_files[i];
+            files[i].exists = file_index->open(environment_files[i], env_cache_directory);
+
+            if (files[i].exists) {
+                file_index->resolve(referenced_variables, files[i]);
+                file_indexes[i] = std::move(file_index);
+            }
         }
         catch (std::runtime_error &error) {
-            std::ostringstream error_stream;
-            error_stream << "[ERROR] File: " << file_path << ", line: " << line_count
-                         << ": " << error.what();
-            throw std::runtime_error(error_stream.str());
+
+            // files that can't be mapped are read whole
+            files[i].read(environment_files[i]);
         }
+    };
+
+    thread_utils::parallel_for(environment_files.size(), [&](unsigned long i, unsigned int) {
+        read_env_file(i);
+    });
+
+    if (this->parameters->lazy_env) {
+        this->read_derived_references(files, file_indexes, referenced_variables);
     }
 
-    template_file.close();
+    for (const auto &file : files) {
+        this->merge_env_file(file);
+    }
 
-    if (!if_statement_evaluations_stack.empty()) {
-        throw std::runtime_error("Expected endif (check if every if statement has a corresponding endif)");
+    // print errors of derived values, but continue
+    for (const auto &error : this->env_var_dictionary.link()) {
+        this->log.error(error);
     }
+}
+
+/*
+ * Read one specific template file and render it into generated_file.
+ * Returns false if template file doesn't exist.
+ */
+bool config_generator::render_file(const std::string &file_path) {
 
-    std::string generated_file = generated_file_stream.str();
+    if (!file_utils::read_file(file_path, this->template_source)) {
+        this->log.warn("Template file ", file_path, " doesn't exist or isn't a file, skipping.");
+        return false;
+    }
+
+    if (!this->parameters->index_file.empty()) {
+        this->analyse_template(file_path, this->template_source);
+    }
+
+    this->renderer.render(this->template_source, file_path, this->generated_file);
+
+    return true;
+}
+
+/*
+ * Read one specific template file and perform configuration generation.
+ * At the end, write it to output and to stdout, if specified.
+ */
+void config_generator::generate_file(const std::string &file_path, const std::string &out_file_path) {
+
+    if (!this->render_file(file_path)) {
+        return;
+    }
 
     if (!out_file_path.empty()) {
-        std::ofstream output_file(out_file_path);
-        output_file << generated_file;
-        std::cout << "Wrote: " << out_file_path << std::endl;
-        output_file.close();
+        this->write_output_file(out_file_path);
+        this->log.info("Wrote: ", out_file_path);
     }
 
     if (this->parameters->output_to_stdout) {
 
-        std::cout << "<<< " << out_file_path << " >>>" << std::endl
-                  << generated_file << std::endl << "<<< " << out_file_path << " end >>>" << std::endl << std::endl;
+        std::cout << "<<< " << out_file_path << " >>>\n";
+        this->generated_file.write_to(std::cout);
+        std::cout << "\n<<< " << out_file_path << " end >>>\n\n";
     }
 }
 
@@ -210,7 +322,7 @@ void config_generator::generate_files() {
                                 this->parameters->output_files.size() > i ? this->parameters->output_files[i] : "");
         }
         catch (std::runtime_error &error) {
-            std::cerr << error.what() << std::endl;
+            this->log.error(error);
         }
     }
 }
@@ -239,9 +351,11 @@ void config_generator::generate_directory(const std::string &name, int indent, c
             snprintf(path, sizeof(path), "%s/%s", name.c_str(), entry->d_name);
             snprintf(base_path, sizeof(base_path), "%s/%s", base_name.c_str(), entry->d_name);
 
-            mkdir(base_path, 0777);
+            if (!base_name.empty()) {
+                this->make_output_directory(base_path);
+            }
 
-            this->generate_directory(path, indent + 2, base_path);
+            this->generate_directory(path, indent + 2, base_name.empty() ? "" : base_path);
         } else {
 
             char path[1024];
@@ -250,33 +364,478 @@ void config_generator::generate_directory(const std::string &name, int indent, c
             snprintf(path, sizeof(path), "%s/%s", name.c_str(), entry->d_name);
             snprintf(base_path, sizeof(base_path), "%s/%s", base_name.c_str(), entry->d_name);
 
-            this->generate_file(path, base_path);
+            this->generate_file(path, base_name.empty() ? "" : base_path);
         }
     }
 
     closedir(dir);
 }
 
+/*
+ * Render only files of template directory that belong to this process' shard.
+ * Shard of every file only depends on its relative path, so all processes split the directory the same way.
+ */
+void config_generator::generate_shard() {
+
+    const std::string &template_directory = this->parameters->template_directory;
+    const std::string &output_directory = this->parameters->output_directory;
+
+    std::vector<std::string> file_names;
+    collect_directory_files(template_directory, "", file_names);
+
+    for (const auto &file_name : file_names) {
+
+        if (shard_utils::file_shard(file_name, this->parameters->shard_count) != this->parameters->shard_index) {
+            continue;
+        }
+
+        std::string out_file_path;
+
+        if (!output_directory.empty()) {
+            out_file_path = output_directory + "/" + file_name;
+            this->make_output_directories(out_file_path.substr(0, out_file_path.rfind('/')));
+        }
+
+        try {
+            this->generate_file(template_directory + "/" + file_name, out_file_path);
+        }
+        catch (std::runtime_error &error) {
+            this->log.error(error);
+        }
+    }
+}
+
+/*
+ * Check that output directories of all shards together contain exactly a full render of template directory:
+ * every file rendered once, with the same contents, and nothing else.
+ * If output directory is specified, verified files are merged into it.
+ * Returns true if shards are complete.
+ */
+bool config_generator::verify_shards() {
+
+    const std::string &template_directory = this->parameters->template_directory;
+    const std::string &output_directory = this->parameters->output_directory;
+    const std::vector<std::string> &shard_directories = this->parameters->verified_shard_directories;
+
+    // relative path -> shard directory that contains it
+    std::map<std::string, std::string> shard_files;
+    bool shards_valid = true;
+
+    for (const auto &shard_directory : shard_directories) {
+
+        std::vector<std::string> file_names;
+
+        // missing shard would otherwise look like an empty one
+        if (!collect_directory_files(shard_directory, "", file_names)) {
+            this->log.error("Shards: can't read shard directory ", shard_directory, ".");
+            shards_valid = false;
+        }
+
+        for (const auto &file_name : file_names) {
+
+            auto shard_file = shard_files.find(file_name);
+
+            if (shard_file != shard_files.end()) {
+                this->log.error("Shards: ", file_name, " is in both ", shard_file->second, " and ", shard_directory,
+                                ".");
+                shards_valid = false;
+                continue;
+            }
+
+            shard_files[file_name] = shard_directory;
+        }
+    }
+
+    std::vector<std::string> file_names;
+
+    if (!collect_directory_files(template_directory, "", file_names)) {
+        this->log.error("Shards: can't read template directory ", template_directory, ".");
+        shards_valid = false;
+    }
+
+    std::string shard_contents;
+    unsigned long verified_count = 0;
+
+    for (const auto &file_name : file_names) {
+
+        try {
+            if (!this->render_file(template_directory + "/" + file_name)) continue;
+        }
+        catch (std::runtime_error &error) {
+            this->log.error(error);
+            shards_valid = false;
+            continue;
+        }
+
+        auto shard_file = shard_files.find(file_name);
+
+        if (shard_file == shard_files.end()) {
+            this->log.error("Shards: ", file_name, " is missing from all shards.");
+            shards_valid = false;
+            continue;
+        }
+
+        std::string shard_file_path = shard_file->second + "/" + file_name;
+        shard_files.erase(shard_file);
+
+        if (!file_utils::read_file(shard_file_path, shard_contents) || shard_contents != this->generated_file.view()) {
+            this->log.error("Shards: ", shard_file_path, " differs from full render.");
+            shards_valid = false;
+            continue;
+        }
+
+        if (!output_directory.empty()) {
+            std::string out_file_path = output_directory + "/" + file_name;
+            this->make_output_directories(out_file_path.substr(0, out_file_path.rfind('/')));
+            this->write_output_file(out_file_path);
+        }
+
+        verified_count++;
+    }
+
+    for (const auto &shard_file : shard_files) {
+        this->log.error("Shards: ", shard_file.second, "/", shard_file.first, " isn't rendered from any template.");
+        shards_valid = false;
+    }
+
+    if (shards_valid) {
+        this->log.info("Verified: ", verified_count, " files in ", shard_directories.size(), " shards.");
+    }
+
+    return shards_valid;
+}
+
 void config_generator::generate_directories() {
 
     try {
-        mkdir(this->parameters->output_directory.c_str(), 0777);
+        if (!this->parameters->output_directory.empty()) {
+            this->make_output_directory(this->parameters->output_directory);
+        }
+
         this->generate_directory(this->parameters->template_directory, 0, this->parameters->output_directory);
     }
     catch (std::runtime_error &error) {
-        std::cerr << error.what() << std::endl;
+        this->log.error(error);
     }
 }
 
-void config_generator::run() {
-    this->read_env_files();
+/*
+ * Name of template in the index: path relative to template directory, or path as given for --file.
+ */
+std::string config_generator::template_name(const std::string &file_path) const {
+
+    const std::string &template_directory = this->parameters->template_directory;
+
+    if (this->parameters->uses_directory && file_path.size() > template_directory.size() &&
+        file_path.compare(0, template_directory.size(), template_directory) == 0 &&
+        file_path[template_directory.size()] == '/') {
+        return file_path.substr(template_directory.size() + 1);
+    }
+
+    return file_path;
+}
+
+/*
+ * Analyse template into index, together with templates it includes, so that template
+ * depends on variables of its partials as well.
+ * Partials that don't exist are skipped here and reported when template is rendered.
+ */
+void config_generator::index_template(const std::string &template_name, const std::string &file_path,
+                                      std::string_view template_source,
+                                      std::unordered_set<std::string> &indexed_partials) {
+
+    std::vector<std::string> include_paths = this->index.add_template(template_name, file_path, template_source,
+                                                                      this->parameters->definer);
+
+    for (const auto &include_path : include_paths) {
+
+        try {
+            const partial_template &partial = this->partials.get(file_path, include_path);
+
+            // every partial is analysed once per template, which also stops include cycles
+            if (indexed_partials.insert(partial.file_path).second) {
+                this->index_template(template_name, partial.file_path, partial.compiled.text, indexed_partials);
+            }
+        }
+        catch (std::runtime_error &) {
+            continue;
+        }
+    }
+}
+
+/*
+ * Paths of all templates: files of template directory or files as given with --file.
+ */
+std::vector<std::string> config_generator::template_file_paths() const {
+
+    std::vector<std::string> file_paths;
+
+    if (this->parameters->uses_directory) {
+
+        std::vector<std::string> file_names;
+        collect_directory_files(this->parameters->template_directory, "", file_names);
+
+        for (const auto &file_name : file_names) {
+            file_paths.push_back(this->parameters->template_directory + "/" + file_name);
+        }
+    } else {
+        file_paths = this->parameters->template_files;
+    }
+
+    return file_paths;
+}
+
+/*
+ * Analyse template at file_path into index, replacing entries it had before.
+ */
+void config_generator::analyse_template(const std::string &file_path, std::string_view template_source) {
+
+    std::string name = this->template_name(file_path);
+    std::unordered_set<std::string> indexed_partials;
+
+    this->index.remove_template(name);
+    this->index_template(name, file_path, template_source, indexed_partials);
+}
+
+/*
+ * Analyse all templates of this run into index, without rendering them.
+ */
+void config_generator::build_index() {
+
+    for (const auto &file_path : this->template_file_paths()) {
+
+        if (!file_utils::read_file(file_path, this->template_source)) {
+            this->log.warn("Template file ", file_path, " doesn't exist or isn't a file, skipping.");
+            continue;
+        }
+
+        this->analyse_template(file_path, this->template_source);
+    }
+}
+
+/*
+ * Bring loaded index up to date: analyse templates whose files changed since they were analysed again,
+ * and remove templates that don't exist anymore. With analyse_new_templates, templates of --file or --dir
+ * that aren't in index yet are analysed too. Returns true if index changed.
+ */
+bool config_generator::refresh_index(bool analyse_new_templates) {
+
+    bool is_changed = false;
+
+    for (const auto &stale_template : this->index.stale_templates()) {
+
+        this->index.remove_template(stale_template.first);
+        is_changed = true;
+
+        if (!stale_template.second.empty() && file_utils::read_file(stale_template.second, this->template_source)) {
+            std::unordered_set<std::string> indexed_partials;
+            this->index_template(stale_template.first, stale_template.second, this->template_source,
+                                 indexed_partials);
+        }
+    }
+
+    if (!analyse_new_templates) {
+        return is_changed;
+    }
+
+    for (const auto &file_path : this->template_file_paths()) {
+
+        if (this->index.contains(this->template_name(file_path)) ||
+            !file_utils::read_file(file_path, this->template_source)) {
+            continue;
+        }
+
+        this->analyse_template(file_path, this->template_source);
+        is_changed = true;
+    }
+
+    return is_changed;
+}
+
+/*
+ * Print templates affected by variables from --affected-by, using saved index if it exists.
+ * If outputs are specified, render only affected templates.
+ */
+void config_generator::generate_affected() {
+
+    const std::string &index_file = this->parameters->index_file;
+
+    bool is_loaded = !index_file.empty() && this->index.load(index_file);
+
+    if (!is_loaded && this->parameters->template_files.empty() && !this->parameters->uses_directory) {
+        this->log.error("Template index ", index_file, " doesn't exist.");
+        return;
+    }
+
+    // saved index can be older than templates, and can miss templates that were added since
+    if (this->refresh_index(true) && !index_file.empty()) {
+        try {
+            this->index.save(index_file);
+        }
+        catch (std::runtime_error &error) {
+            this->log.error(error);
+        }
+    }
+
+    // derived variables change with variables they reference, so templates that use them are affected too
+    std::vector<std::string> affected_variables = this->parameters->affected_variables;
+
+    if (!this->parameters->environment_files.empty()) {
+        this->read_env_files();
+        affected_variables = this->env_var_dictionary.dependents(affected_variables);
+    }
+
+    std::set<std::string> affected_templates = this->index.affected_by(affected_variables);
+
+    for (const auto &affected_template : affected_templates) {
+        std::cout << affected_template << '\n';
+    }
+
+    // only query was requested
+    if (this->parameters->output_files.empty() && !this->parameters->output_to_stdout) {
+        return;
+    }
 
     if (this->parameters->uses_directory) {
 
+        const std::string &output_directory = this->parameters->output_directory;
+
+        for (const auto &affected_template : affected_templates) {
+
+            std::string out_file_path;
+
+            if (!output_directory.empty()) {
+                out_file_path = output_directory + "/" + affected_template;
+                this->make_output_directories(out_file_path.substr(0, out_file_path.rfind('/')));
+            }
+
+            try {
+                this->generate_file(this->parameters->template_directory + "/" + affected_template, out_file_path);
+            }
+            catch (std::runtime_error &error) {
+                this->log.error(error);
+            }
+        }
+    } else {
+
+        for (unsigned long i = 0; i < this->parameters->template_files.size(); i++) {
+
+            if (affected_templates.count(this->parameters->template_files[i]) == 0) continue;
+
+            try {
+                this->generate_file(this->parameters->template_files[i],
+                                    this->parameters->output_files.size() > i ? this->parameters->output_files[i] : "");
+            }
+            catch (std::runtime_error &error) {
+                this->log.error(error);
+            }
+        }
+    }
+}
+
+/*
+ * Check all templates and the templates they include in parallel, without rendering them, and print all errors.
+ * Returns false if any template has errors.
+ */
+bool config_generator::check_templates() {
+
+    // dictionary is read from multiple threads, so derived values can't be evaluated while checking
+    this->env_var_dictionary.evaluate_all();
+
+    std::vector<std::string> file_paths = this->template_file_paths();
+
+    template_checker checker(this->parameters->definer, this->env_var_dictionary, this->partials);
+
+    unsigned long partial_count = 0;
+    std::vector<std::string> errors = checker.check(file_paths, partial_count);
+
+    for (const auto &error : errors) {
+        this->log.error(error);
+    }
+
+    this->log.info("Checked: ", file_paths.size(), " templates and ", partial_count, " included templates, ",
+                   errors.size(), " errors.");
+
+    return errors.empty();
+}
+
+/*
+ * Generate configurations as specified by parameters.
+ * Returns false if generated outputs were found to be wrong.
+ */
+bool config_generator::generate() {
+
+    if (this->parameters->only_check) {
+        this->read_env_files();
+        return this->check_templates();
+    }
+
+    if (!this->parameters->affected_variables.empty()) {
+        this->generate_affected();
+        return true;
+    }
+
+    // templates that this run doesn't render keep their entries, so that saved index stays complete
+    if (!this->parameters->index_file.empty() && this->index.load(this->parameters->index_file)) {
+        this->refresh_index(false);
+    }
+
+    this->read_env_files();
+
+    if (!this->parameters->verified_shard_directories.empty()) {
+
+        return this->verify_shards();
+
+    } else if (this->parameters->shard_count > 0) {
+
+        this->generate_shard();
+
+    } else if (this->parameters->uses_directory) {
+
         this->generate_directories();
 
     } else {
 
         this->generate_files();
     }
-}
\ No newline at end of file
+
+    if (!this->parameters->index_file.empty()) {
+        try {
+            this->index.save(this->parameters->index_file);
+        }
+        catch (std::runtime_error &error) {
+            this->log.error(error);
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Open archive if outputs go into one, generate configurations and finish the archive.
+ * Returns false if generating or writing outputs failed.
+ */
+bool config_generator::run() {
+
+    try {
+        if (!this->parameters->archive_file.empty()) {
+            this->archive.open(this->parameters->archive_file, this->parameters->compress_archive);
+        }
+    }
+    catch (std::runtime_error &error) {
+        this->log.error(error);
+        return false;
+    }
+
+    bool generate_success = this->generate();
+
+    try {
+        this->archive.close();
+    }
+    catch (std::runtime_error &error) {
+        this->log.error(error);
+        return false;
+    }
+
+    return generate_success;
+}
@@ -6,17 +6,53 @@
 #define CONFIG_GENERATOR_CONFIG_GENERATOR_H
 
 #include "generator_parameters.h"
+#include "logger.h"
+#include "output_buffer.h"
+#include "template_renderer.h"
+#include "partial_cache.h"
+#include "template_index.h"
+#include "env_file.h"
+#include "env_dictionary.h"
+#include "env_index.h"
+#include "archive_writer.h"
+#include <memory>
 #include <unordered_map>
+#include <unordered_set>
 
 class config_generator {
 
 private:
+    // declared first, so that it is destroyed last and writes everything logged
+    logger log;
+
     generator_parameters *parameters;
-    std::unordered_map<std::string, std::string> env_var_dictionary;
+    env_dictionary env_var_dictionary;
+
+    // included templates, compiled once for all templates
+    partial_cache partials;
+
+    // reused by every generated file, so that steady state rendering doesn't allocate
+    template_renderer renderer;
+    std::string template_source;
+    output_buffer generated_file;
+
+    template_index index;
+
+    archive_writer archive;
+
+    void read_derived_references(std::vector<env_file> &files,
+                                 const std::vector<std::unique_ptr<env_index>> &file_indexes,
+                                 const std::vector<std::string> &referenced_variables);
 
     void read_env_files();
 
-    void read_env_file(const std::string &file_path);
+    void make_output_directory(const std::string &directory_path);
+
+    void make_output_directories(const std::string &directory_path);
+
+    void write_output_file(const std::string &out_file_path);
+
+    void merge_env_file(const env_file &file);
 
     void generate_directory(const std::string &name, int indent, const std::string &base_name);
 
@@ -26,10 +62,35 @@ private:
 
     void generate_files();
 
+    bool render_file(const std::string &file_path);
+
+    void generate_shard();
+
+    bool verify_shards();
+
+    std::string template_name(const std::string &file_path) const;
+
+    void index_template(const std::string &template_name, const std::string &file_path,
+                        std::string_view template_source, std::unordered_set<std::string> &indexed_partials);
+
+    std::vector<std::string> template_file_paths() const;
+
+    void analyse_template(const std::string &file_path, std::string_view template_source);
+
+    void build_index();
+
+    bool refresh_index(bool analyse_new_templates);
+
+    bool check_templates();
+
+    void generate_affected();
+
+    bool generate();
+
 public:
     explicit config_generator(generator_parameters &parameters);
 
-    void run();
+    bool run();
 };
 
 
@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <sstream>
+#include <unordered_set>
+#include "env_dictionary.h"
+#include "parsing_utils.h"
+
+env_dictionary::env_dictionary(std::string definer) : definer(std::move(definer)) {}
+
+/*
+ * Return names of variables referenced in value, in order, such as HOST and PORT in %{HOST}:%{PORT}.
+ */
+std::vector<std::string> env_dictionary::references(std::string_view value) const {
+
+    std::vector<std::string> names;
+
+    size_t position = 0, variable_start, name_end;
+
+    while (parsing_utils::find_variable(value, this->definer, position, variable_start, name_end)) {
+
+        size_t name_start = variable_start + this->definer.size() + 1;
+
+        if (name_end > name_start) {
+            names.emplace_back(value.substr(name_start, name_end - name_start));
+        }
+
+        position = name_end + 1;
+    }
+
+    return names;
+}
+
+/*
+ * Return given names, followed by names of derived variables that reference any of them,
+ * directly or through other derived variables, such as UPSTREAM for HOST with UPSTREAM=%{HOST}:%{PORT}.
+ */
+std::vector<std::string> env_dictionary::dependents(const std::vector<std::string> &names) const {
+
+    std::vector<std::string> dependent_names(names);
+    std::unordered_set<std::string> found_names(names.begin(), names.end());
+
+    // derived variables are few, so they are scanned again until no new dependent is found
+    bool is_found = true;
+
+    while (is_found) {
+
+        is_found = false;
+
+        for (const auto &derived_variable : this->derived_variables) {
+
+            if (found_names.count(derived_variable.first) > 0) continue;
+
+            const std::vector<std::string> &references = derived_variable.second.references;
+
+            if (std::any_of(references.begin(), references.end(), [&](const std::string &reference) {
+                return found_names.count(reference) > 0;
+            })) {
+                found_names.insert(derived_variable.first);
+                dependent_names.push_back(derived_variable.first);
+                is_found = true;
+            }
+        }
+    }
+
+    return dependent_names;
+}
+
+/*
+ * Return value of variable, or nullptr if it isn't defined.
+ * Derived value is evaluated the first time it is asked for.
+ */
+const env_value *env_dictionary::find(const std::string &name) {
+
+    auto variable = this->variables.find(name);
+
+    if (variable == this->variables.end()) {
+        return nullptr;
+    }
+
+    if (variable->second.is_derived) {
+        this->evaluate(variable->second);
+    }
+
+    return &variable->second;
+}
+
+/*
+ * Return value of variable, or nullptr if it isn't defined, without evaluating it.
+ * Derived values have to be evaluated first, with evaluate_all.
+ */
+const env_value *env_dictionary::find_evaluated(const std::string &name) const {
+
+    auto variable = this->variables.find(name);
+
+    return variable == this->variables.end() ? nullptr : &variable->second;
+}
+
+/*
+ * Evaluate all derived values, so that dictionary can be read from multiple threads with find_evaluated.
+ */
+void env_dictionary::evaluate_all() {
+
+    for (const auto &derived_variable : this->derived_variables) {
+        this->find(derived_variable.first);
+    }
+}
+
+/*
+ * Define variable, replacing previous value if there is one.
+ * Values that reference other variables have to be checked with link before they are used.
+ */
+void env_dictionary::define(const std::string &name, const env_value &value, const std::string &file_path,
+                            int line_count) {
+
+    env_value &variable = this->variables[name] = value;
+
+    size_t variable_start, name_end;
+    std::vector<std::string> value_references;
+
+    if (parsing_utils::find_variable(value.value, this->definer, 0, variable_start, name_end)) {
+        value_references = this->references(value.value);
+    }
+
+    variable.is_derived = !value_references.empty();
+
+    if (variable.is_derived) {
+        this->derived_variables[name] = {file_path, line_count, derived_state::UNCHECKED, false,
+                                         std::move(value_references)};
+    } else {
+        this->derived_variables.erase(name);
+    }
+}
+
+/*
+ * Check that derived variable only references defined variables and doesn't reference itself,
+ * directly or through other variables. path contains variables that are being checked.
+ * Returns false and removes variable if it can't be evaluated.
+ */
+bool env_dictionary::check_derived(const std::string &name, std::vector<std::string> &path,
+                                   std::vector<std::string> &errors) {
+
+    derived_variable &variable = this->derived_variables.at(name);
+
+    if (variable.state == derived_state::VALID) return true;
+    if (variable.state == derived_state::INVALID) return false;
+
+    std::ostringstream error_stream;
+    error_stream << "File: " << variable.file_path << ", line: " << variable.line_count << ": ";
+
+    if (variable.state == derived_state::CHECKING) {
+
+        error_stream << "Variable " << name << " references itself: ";
+
+        // whole cycle is reported once, by the variable that closes it
+        for (auto cycle_name = std::find(path.begin(), path.end(), name); cycle_name != path.end(); cycle_name++) {
+            error_stream << *cycle_name << " -> ";
+            this->derived_variables.at(*cycle_name).is_reported = true;
+        }
+
+        error_stream << name << ".";
+        errors.push_back(error_stream.str());
+
+        return false;
+    }
+
+    variable.state = derived_state::CHECKING;
+    path.push_back(name);
+
+    bool is_valid = true;
+
+    for (const auto &reference : variable.references) {
+
+        if (this->derived_variables.count(reference) > 0) {
+
+            if (!this->check_derived(reference, path, errors)) {
+
+                if (!variable.is_reported) {
+                    std::ostringstream reference_error_stream;
+                    reference_error_stream << error_stream.str() << "Variable " << name << " references variable "
+                                           << reference << ", which can't be evaluated.";
+                    errors.push_back(reference_error_stream.str());
+                    variable.is_reported = true;
+                }
+
+                is_valid = false;
+                break;
+            }
+
+        } else if (this->variables.count(reference) == 0) {
+
+            std::ostringstream reference_error_stream;
+            reference_error_stream << error_stream.str() << "Variable " << name << " references undefined variable "
+                                   << reference << ".";
+            errors.push_back(reference_error_stream.str());
+            variable.is_reported = true;
+
+            is_valid = false;
+            break;
+        }
+    }
+
+    path.pop_back();
+
+    variable.state = is_valid ? derived_state::VALID : derived_state::INVALID;
+
+    if (!is_valid) {
+        this->variables.erase(name);
+    }
+
+    return is_valid;
+}
+
+/*
+ * Build dependency graph of derived variables, once all environment files are merged, so that
+ * references take the value of variable from the last file that defines it.
+ * Variables that can't be evaluated are removed. Returns their errors.
+ */
+std::vector<std::string> env_dictionary::link() {
+
+    std::vector<std::string> errors;
+    std::vector<std::string> path;
+
+    for (const auto &derived_variable : this->derived_variables) {
+        this->check_derived(derived_variable.first, path, errors);
+    }
+
+    return errors;
+}
+
+/*
+ * Replace derived value with its evaluation, evaluating variables it references first.
+ * Values are only evaluated after link, which removes those with undefined references and cycles;
+ * should one be evaluated anyway, undefined references are kept as they are and cycles end at the value itself.
+ */
+void env_dictionary::evaluate(env_value &value) {
+
+    // references back to this value, through a cycle, take it as it is written
+    value.is_derived = false;
+
+    const std::string derived_value = value.value;
+    std::string evaluated_value;
+
+    size_t position = 0, variable_start, name_end;
+
+    while (parsing_utils::find_variable(derived_value, this->definer, position, variable_start, name_end)) {
+
+        size_t name_start = variable_start + this->definer.size() + 1;
+
+        evaluated_value.append(derived_value, position, variable_start - position);
+
+        const env_value *referenced_value = nullptr;
+
+        if (name_end > name_start) {
+            referenced_value = this->find(derived_value.substr(name_start, name_end - name_start));
+        }
+
+        // empty (%{}) and undefined references are kept as they are
+        if (referenced_value == nullptr) {
+            evaluated_value.append(derived_value, variable_start, name_end + 1 - variable_start);
+        } else {
+            evaluated_value.append(referenced_value->value);
+        }
+
+        position = name_end + 1;
+    }
+
+    evaluated_value.append(derived_value, position, std::string::npos);
+
+    value = env_value(std::move(evaluated_value));
+}
@@ -0,0 +1,71 @@
+#ifndef CONFIG_GENERATOR_ENV_DICTIONARY_H
+#define CONFIG_GENERATOR_ENV_DICTIONARY_H
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "env_file.h"
+
+/*
+ * Environment variables of all environment files, merged.
+ * Values can reference other variables, such as UPSTREAM=%{HOST}:%{PORT}. References are checked for cycles
+ * and undefined variables once all files are merged, but derived values are only evaluated when they are
+ * first used and then kept, so variables that no template uses are never evaluated.
+ * Evaluation changes the dictionary, so it can't be used from multiple threads at once,
+ * unless all values are evaluated first with evaluate_all.
+ */
+class env_dictionary {
+
+private:
+    enum class derived_state : uint8_t {
+        UNCHECKED,
+        CHECKING,
+        VALID,
+        INVALID
+    };
+
+    /*
+     * Variable whose value references other variables, with its definition for error messages.
+     */
+    struct derived_variable {
+        std::string file_path;
+        int line_count;
+        derived_state state;
+        bool is_reported;
+
+        // names of variables that value references, kept after value is evaluated
+        std::vector<std::string> references;
+    };
+
+    std::string definer;
+    std::unordered_map<std::string, env_value> variables;
+
+    // sorted, so that errors are reported in the same order every time
+    std::map<std::string, derived_variable> derived_variables;
+
+    bool check_derived(const std::string &name, std::vector<std::string> &path, std::vector<std::string> &errors);
+
+    void evaluate(env_value &value);
+
+public:
+    explicit env_dictionary(std::string definer);
+
+    const env_value *find(const std::string &name);
+
+    const env_value *find_evaluated(const std::string &name) const;
+
+    void evaluate_all();
+
+    void define(const std::string &name, const env_value &value, const std::string &file_path, int line_count);
+
+    std::vector<std::string> link();
+
+    std::vector<std::string> references(std::string_view value) const;
+
+    std::vector<std::string> dependents(const std::vector<std::string> &names) const;
+};
+
+
+#endif //CONFIG_GENERATOR_ENV_DICTIONARY_H
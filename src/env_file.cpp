@@ -0,0 +1,91 @@
+#include <fstream>
+#include <stdexcept>
+#include "env_file.h"
+#include "string_utils.h"
+#include "parsing_utils.h"
+
+env_value::env_value(std::string value)
+        : value(std::move(value)) {
+    this->folded = string_utils::fold_ascii(this->value);
+    this->has_space = this->value.find(' ') != std::string::npos;
+
+    // list items are split once, so that %FOR statements don't parse the value per render
+    this->is_list = this->value.size() >= 2 && this->value.front() == '[' && this->value.back() == ']';
+
+    if (!this->is_list) return;
+
+    std::string_view list = std::string_view(this->value).substr(1, this->value.size() - 2);
+
+    size_t item_start = 0;
+
+    while (true) {
+
+        size_t item_end = list.find(',', item_start);
+
+        if (item_end == std::string_view::npos) {
+            item_end = list.size();
+        }
+
+        std::string_view item = string_utils::trim_view(list.substr(item_start, item_end - item_start));
+
+        // values can't be empty, so empty items (such as in [A,, B]) are left out
+        if (!item.empty()) {
+            this->items.emplace_back(std::string(item));
+        }
+
+        if (item_end == list.size()) break;
+
+        item_start = item_end + 1;
+    }
+}
+
+/*
+ * Read and parse environment file.
+ * Lines that can't be parsed are kept with their error, so that they can be reported when file is merged.
+ */
+void env_file::read(const std::string &path) {
+
+    this->file_path = path;
+    this->lines.clear();
+
+    std::ifstream env_file_stream(path);
+
+    this->exists = env_file_stream.good();
+
+    if (!this->exists) {
+        return;
+    }
+
+    std::string line;
+    int line_count = 1;
+    while (std::getline(env_file_stream, line)) {
+
+        std::string trimmed_line = string_utils::trim(line);
+
+        // ignore empty lines
+        if (trimmed_line.length() == 0) continue;
+
+        env_file_line parsed_line;
+        parsed_line.line_count = line_count;
+
+        try {
+            std::pair<std::string, std::string> name_value_pair = parsing_utils::get_name_value_pair(trimmed_line,
+                                                                                                     '=');
+            parsed_line.name = std::move(name_value_pair.first);
+            parsed_line.value = env_value(std::move(name_value_pair.second));
+        }
+        catch (std::runtime_error &error) {
+
+            // keep error, but continue
+            parsed_line.error = error.what();
+            this->lines.push_back(std::move(parsed_line));
+            continue;
+        }
+
+        this->lines.push_back(std::move(parsed_line));
+
+        line_count++;
+    }
+
+    env_file_stream.close();
+}
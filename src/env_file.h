@@ -0,0 +1,56 @@
+#ifndef CONFIG_GENERATOR_ENV_FILE_H
+#define CONFIG_GENERATOR_ENV_FILE_H
+
+#include <string>
+#include <vector>
+
+/*
+ * Value of environment variable, with case folded copy, prepared once when env file is read,
+ * so that case insensitive comparisons don't have to fold it again.
+ */
+struct env_value {
+    std::string value;
+    std::string folded;
+
+    // spaces split if statement words when value is substituted into if statement
+    bool has_space = false;
+
+    // value references other variables and is evaluated when it is first used, see env_dictionary
+    bool is_derived = false;
+
+    // values written as [A, B, C] are lists, which %FOR statements iterate over
+    bool is_list = false;
+    std::vector<env_value> items;
+
+    env_value() = default;
+
+    explicit env_value(std::string value);
+};
+
+/*
+ * One non-empty line of environment file: either a parsed variable or an error.
+ */
+struct env_file_line {
+    int line_count = 0;
+    std::string name;
+    env_value value;
+
+    // not empty if line couldn't be parsed
+    std::string error;
+};
+
+/*
+ * Parsed contents of one environment file, kept in file order.
+ * Reading doesn't touch any shared state, so several files can be read at the same time
+ * and merged afterwards in the order they were given.
+ */
+struct env_file {
+    std::string file_path;
+    bool exists = false;
+    std::vector<env_file_line> lines;
+
+    void read(const std::string &path);
+};
+
+
+#endif //CONFIG_GENERATOR_ENV_FILE_H
@@ -0,0 +1,293 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "env_index.h"
+#include "string_utils.h"
+#include "parsing_utils.h"
+#include "shard_utils.h"
+
+const std::string CACHE_HEADER = "config-generator env index v1";
+
+/*
+ * Cache starts with text header, padded to this size, so that entries after it are aligned.
+ */
+const size_t CACHE_HEADER_SIZE = 512;
+
+env_index::~env_index() {
+
+    if (this->data != nullptr) {
+        munmap(const_cast<char *>(this->data), this->size);
+    }
+
+    if (this->cache_mapping != nullptr) {
+        munmap(this->cache_mapping, this->cache_size);
+    }
+
+    if (this->file_descriptor >= 0) {
+        close(this->file_descriptor);
+    }
+}
+
+std::string_view env_index::entry_key(const env_index_entry &entry) const {
+    return std::string_view(this->data + entry.line_offset + entry.key_offset, entry.key_length);
+}
+
+/*
+ * Scan whole environment file and index every line that has a variable name.
+ * Line counts follow env_file: only lines that parse into a variable are counted.
+ */
+void env_index::build() {
+
+    std::vector<env_index_entry> &entries = this->built_entries;
+    entries.clear();
+
+    std::string_view text(this->data, this->size);
+
+    size_t line_start = 0;
+    int32_t line_count = 1;
+
+    while (line_start < text.size()) {
+
+        size_t line_end = text.find('\n', line_start);
+
+        if (line_end == std::string_view::npos) {
+            line_end = text.size();
+        }
+
+        std::string_view line = text.substr(line_start, line_end - line_start);
+        std::string_view trimmed_line = string_utils::trim_view(line);
+
+        size_t equals_position = trimmed_line.find('=');
+
+        if (!trimmed_line.empty() && equals_position != std::string_view::npos) {
+
+            std::string_view key = string_utils::trim_view(trimmed_line.substr(0, equals_position));
+            std::string_view value = string_utils::trim_view(trimmed_line.substr(equals_position + 1));
+
+            bool is_valid = !key.empty() && !value.empty() &&
+                            trimmed_line.find('=', equals_position + 1) == std::string_view::npos;
+
+            if (!key.empty()) {
+                entries.push_back({static_cast<uint64_t>(line_start), static_cast<uint32_t>(line.size()),
+                                         static_cast<uint32_t>(key.size()),
+                                         static_cast<uint32_t>(key.data() - line.data()), line_count});
+            }
+
+            if (is_valid) {
+                line_count++;
+            }
+        }
+
+        line_start = line_end + 1;
+    }
+
+    std::stable_sort(entries.begin(), entries.end(), [this](const env_index_entry &a, const env_index_entry &b) {
+        return this->entry_key(a) < this->entry_key(b);
+    });
+
+    this->entries = entries.data();
+    this->entry_count = entries.size();
+}
+
+/*
+ * Header of cache file: format, identity of environment file and number of entries.
+ */
+static std::string cache_header(const std::string &file_identity, size_t entry_count) {
+
+    std::ostringstream header_stream;
+    header_stream << CACHE_HEADER << '\n' << file_identity << '\n' << entry_count << '\n';
+
+    std::string header = header_stream.str();
+    header.resize(CACHE_HEADER_SIZE, '\0');
+
+    return header;
+}
+
+/*
+ * Memory map index from cache, if it was built from the same version of environment file.
+ * Entries are used directly from the mapping, so loading doesn't depend on size of index.
+ */
+bool env_index::load_cache(const std::string &cache_path, const std::string &file_identity) {
+
+    int cache_descriptor = ::open(cache_path.c_str(), O_RDONLY);
+
+    if (cache_descriptor < 0) {
+        return false;
+    }
+
+    struct stat cache_stat{};
+    void *mapping = MAP_FAILED;
+
+    if (fstat(cache_descriptor, &cache_stat) == 0 && static_cast<size_t>(cache_stat.st_size) >= CACHE_HEADER_SIZE) {
+        mapping = mmap(nullptr, static_cast<size_t>(cache_stat.st_size), PROT_READ, MAP_PRIVATE, cache_descriptor, 0);
+    }
+
+    close(cache_descriptor);
+
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    size_t mapping_size = static_cast<size_t>(cache_stat.st_size);
+    size_t entry_count = (mapping_size - CACHE_HEADER_SIZE) / sizeof(env_index_entry);
+
+    bool is_valid = mapping_size == CACHE_HEADER_SIZE + entry_count * sizeof(env_index_entry) &&
+                    std::string_view(static_cast<const char *>(mapping), CACHE_HEADER_SIZE) ==
+                    cache_header(file_identity, entry_count);
+
+    if (!is_valid) {
+        munmap(mapping, mapping_size);
+        return false;
+    }
+
+    this->cache_mapping = mapping;
+    this->cache_size = mapping_size;
+    this->entries = reinterpret_cast<const env_index_entry *>(static_cast<const char *>(mapping) + CACHE_HEADER_SIZE);
+    this->entry_count = entry_count;
+
+    return true;
+}
+
+/*
+ * Save index to cache. Index is written to temporary file first, so that processes reading
+ * the cache at the same time never see partially written index.
+ */
+void env_index::save_cache(const std::string &cache_path, const std::string &file_identity) const {
+
+    std::ostringstream temporary_path_stream;
+    temporary_path_stream << cache_path << ".tmp." << getpid();
+    std::string temporary_path = temporary_path_stream.str();
+
+    std::ofstream cache_file(temporary_path, std::ios::binary);
+
+    // cache is only an optimization, so failing to write it isn't an error
+    if (!cache_file.good()) {
+        return;
+    }
+
+    cache_file << cache_header(file_identity, this->entry_count);
+    cache_file.write(reinterpret_cast<const char *>(this->entries),
+                     static_cast<std::streamsize>(this->entry_count * sizeof(env_index_entry)));
+    cache_file.close();
+
+    if (cache_file.good()) {
+        rename(temporary_path.c_str(), cache_path.c_str());
+    } else {
+        unlink(temporary_path.c_str());
+    }
+}
+
+/*
+ * Memory map environment file and load its index from cache directory, or build it (and save it to cache).
+ * Cache directory can be empty, then index is built every time.
+ * Returns false if environment file doesn't exist.
+ */
+bool env_index::open(const std::string &file_path, const std::string &cache_directory) {
+
+    this->file_descriptor = ::open(file_path.c_str(), O_RDONLY);
+
+    if (this->file_descriptor < 0) {
+        return false;
+    }
+
+    struct stat file_stat{};
+
+    if (fstat(this->file_descriptor, &file_stat) != 0) {
+        return false;
+    }
+
+    this->size = static_cast<size_t>(file_stat.st_size);
+
+    if (this->size > 0) {
+
+        void *mapping = mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, this->file_descriptor, 0);
+
+        if (mapping == MAP_FAILED) {
+            std::ostringstream error_stream;
+            error_stream << "Can't map environment file " << file_path << ".";
+            throw std::runtime_error(error_stream.str());
+        }
+
+        this->data = static_cast<const char *>(mapping);
+    }
+
+    if (cache_directory.empty()) {
+        this->build();
+        return true;
+    }
+
+    // cached index is valid only for exactly the same file contents
+    std::ostringstream identity_stream;
+    identity_stream << file_stat.st_dev << ' ' << file_stat.st_ino << ' ' << file_stat.st_size << ' '
+                    << file_stat.st_mtim.tv_sec << '.' << file_stat.st_mtim.tv_nsec;
+
+    // cache is named after absolute path, so that it is found from any working directory
+    char *absolute_path = realpath(file_path.c_str(), nullptr);
+    std::string cache_name = absolute_path != nullptr ? absolute_path : file_path;
+    free(absolute_path);
+
+    std::ostringstream cache_path_stream;
+    cache_path_stream << cache_directory << "/" << std::hex << shard_utils::path_hash(cache_name) << ".envidx";
+
+    if (!this->load_cache(cache_path_stream.str(), identity_stream.str())) {
+        this->build();
+        this->save_cache(cache_path_stream.str(), identity_stream.str());
+    }
+
+    return true;
+}
+
+/*
+ * Parse only lines of given variables into file, in the order they appear in environment file,
+ * so that merging it gives the same values and warnings as reading whole file.
+ */
+void env_index::resolve(const std::vector<std::string> &variable_names, env_file &file) const {
+
+    std::vector<const env_index_entry *> resolved_entries;
+
+    for (const auto &variable_name : variable_names) {
+
+        auto range = std::equal_range(this->entries, this->entries + this->entry_count, variable_name,
+                                      [this](const auto &a, const auto &b) {
+                                          if constexpr (std::is_same_v<std::decay_t<decltype(a)>, env_index_entry>) {
+                                              return this->entry_key(a) < std::string_view(b);
+                                          } else {
+                                              return std::string_view(a) < this->entry_key(b);
+                                          }
+                                      });
+
+        for (auto entry = range.first; entry != range.second; ++entry) {
+            resolved_entries.push_back(&*entry);
+        }
+    }
+
+    std::sort(resolved_entries.begin(), resolved_entries.end(),
+              [](const env_index_entry *a, const env_index_entry *b) { return a->line_offset < b->line_offset; });
+
+    for (const auto *entry : resolved_entries) {
+
+        std::string trimmed_line(string_utils::trim_view(std::string_view(this->data + entry->line_offset,
+                                                                           entry->line_length)));
+
+        env_file_line parsed_line;
+        parsed_line.line_count = entry->line_count;
+
+        try {
+            std::pair<std::string, std::string> name_value_pair = parsing_utils::get_name_value_pair(trimmed_line,
+                                                                                                     '=');
+            parsed_line.name = std::move(name_value_pair.first);
+            parsed_line.value = env_value(std::move(name_value_pair.second));
+        }
+        catch (std::runtime_error &error) {
+            parsed_line.error = error.what();
+        }
+
+        file.lines.push_back(std::move(parsed_line));
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef CONFIG_GENERATOR_ENV_INDEX_H
+#define CONFIG_GENERATOR_ENV_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "env_file.h"
+
+/*
+ * Position of one variable line in environment file.
+ */
+struct env_index_entry {
+    uint64_t line_offset;
+    uint32_t line_length;
+    uint32_t key_length;
+
+    // offset of key from line_offset
+    uint32_t key_offset;
+
+    // line number as reported by env_file, which counts only valid lines
+    int32_t line_count;
+};
+
+/*
+ * Sorted index of variable names in environment file, which is memory mapped,
+ * so that only the lines of variables that are actually used need to be read and parsed.
+ * Index can be saved to a cache directory and is reused for as long as environment file doesn't change.
+ */
+class env_index {
+
+private:
+    int file_descriptor = -1;
+    const char *data = nullptr;
+    size_t size = 0;
+
+    // sorted by key, lines of same key in file order
+    // points either into built_entries or into memory mapped cache file
+    const env_index_entry *entries = nullptr;
+    size_t entry_count = 0;
+
+    std::vector<env_index_entry> built_entries;
+
+    void *cache_mapping = nullptr;
+    size_t cache_size = 0;
+
+    std::string_view entry_key(const env_index_entry &entry) const;
+
+    void build();
+
+    bool load_cache(const std::string &cache_path, const std::string &file_identity);
+
+    void save_cache(const std::string &cache_path, const std::string &file_identity) const;
+
+public:
+    env_index() = default;
+
+    env_index(const env_index &) = delete;
+
+    env_index &operator=(const env_index &) = delete;
+
+    ~env_index();
+
+    bool open(const std::string &file_path, const std::string &cache_directory);
+
+    void resolve(const std::vector<std::string> &variable_names, env_file &file) const;
+};
+
+
+#endif //CONFIG_GENERATOR_ENV_INDEX_H
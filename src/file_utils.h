@@ -0,0 +1,54 @@
+#ifndef CONFIG_GENERATOR_FILE_UTILS_H
+#define CONFIG_GENERATOR_FILE_UTILS_H
+
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/*
+ * Utilities for reading template files
+ */
+namespace file_utils {
+
+    /*
+     * Read whole file into contents, reusing its capacity.
+     * Returns false if file can't be opened or isn't a regular file, such as a directory.
+     */
+    inline bool read_file(const std::string &file_path, std::string &contents) {
+
+        int file_descriptor = open(file_path.c_str(), O_RDONLY);
+
+        if (file_descriptor < 0) {
+            return false;
+        }
+
+        struct stat file_stat{};
+
+        // directories open fine, but have no size to read
+        if (fstat(file_descriptor, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+            close(file_descriptor);
+            return false;
+        }
+
+        contents.resize(static_cast<size_t>(file_stat.st_size));
+
+        size_t read_size = 0;
+
+        while (read_size < contents.size()) {
+
+            ssize_t chunk_size = read(file_descriptor, &contents[read_size], contents.size() - read_size);
+
+            if (chunk_size <= 0) break;
+
+            read_size += static_cast<size_t>(chunk_size);
+        }
+
+        contents.resize(read_size);
+        close(file_descriptor);
+
+        return true;
+    }
+}
+
+#endif //CONFIG_GENERATOR_FILE_UTILS_H
@@ -10,16 +10,35 @@
 
 const std::string
         PARAM_ENV = "env",
+        PARAM_LAZY_ENV = "lazy-env",
+        PARAM_ENV_CACHE = "env-cache",
         PARAM_FILE = "file",
         PARAM_DIR = "dir",
         PARAM_OUT = "out",
         PARAM_STDOUT = "stdout",
+        PARAM_ARCHIVE = "archive",
+        PARAM_ARCHIVE_COMPRESS = "archive-compress",
         PARAM_DEFINER = "definer",
         PARAM_CASE_SENSITIVE = "case-sensitive",
+        PARAM_INDEX = "index",
+        PARAM_AFFECTED_BY = "affected-by",
+        PARAM_SHARD = "shard",
+        PARAM_VERIFY_SHARDS = "verify-shards",
+        PARAM_CHECK = "check",
+        PARAM_QUIET = "quiet",
+        PARAM_LOG_LEVEL = "log-level",
+        PARAM_LOG_FORMAT = "log-format",
         PARAM_HELP = "help",
 
         VALUE_TRUE = "true",
-        VALUE_FALSE = "false";
+        VALUE_FALSE = "false",
+
+        LEVEL_ERROR = "error",
+        LEVEL_WARN = "warn",
+        LEVEL_INFO = "info",
+
+        FORMAT_TEXT = "text",
+        FORMAT_JSON = "json";
 
 /*
  * Constructor
@@ -37,6 +56,11 @@ void generator_parameters::set_argument(const std::string &argument_name, const
 
     if (argument_name == PARAM_ENV) {
         this->environment_files.push_back(argument_value);
+    } else if (argument_name == PARAM_LAZY_ENV) {
+        this->lazy_env = argument_value != VALUE_FALSE;
+    } else if (argument_name == PARAM_ENV_CACHE) {
+        this->env_cache_directory = argument_value;
+        this->lazy_env = true;
     } else if (argument_name == PARAM_FILE) {
         this->template_files.push_back(argument_value);
     } else if (argument_name == PARAM_DIR) {
@@ -45,15 +69,97 @@ void generator_parameters::set_argument(const std::string &argument_name, const
         this->output_files.push_back(argument_value);
     } else if (argument_name == PARAM_STDOUT) {
         this->output_to_stdout = argument_value != VALUE_FALSE;
+    } else if (argument_name == PARAM_ARCHIVE) {
+        this->archive_file = argument_value;
+    } else if (argument_name == PARAM_ARCHIVE_COMPRESS) {
+        this->compress_archive = argument_value != VALUE_FALSE;
     } else if (argument_name == PARAM_DEFINER) {
         this->definer = argument_value;
     } else if (argument_name == PARAM_CASE_SENSITIVE) {
         this->is_case_sensitive = argument_value != VALUE_FALSE;
+    } else if (argument_name == PARAM_INDEX) {
+        this->index_file = argument_value;
+    } else if (argument_name == PARAM_AFFECTED_BY) {
+        this->affected_variables.push_back(argument_value);
+    } else if (argument_name == PARAM_SHARD) {
+        this->set_shard(argument_value);
+    } else if (argument_name == PARAM_VERIFY_SHARDS) {
+        this->verified_shard_directories.push_back(argument_value);
+    } else if (argument_name == PARAM_CHECK) {
+        this->only_check = argument_value != VALUE_FALSE;
+    } else if (argument_name == PARAM_QUIET) {
+        this->logging_level = log_level::ERROR;
+    } else if (argument_name == PARAM_LOG_LEVEL) {
+        this->set_log_level(argument_value);
+    } else if (argument_name == PARAM_LOG_FORMAT) {
+        this->set_log_format(argument_value);
     } else {
         this->display_help = true;
     }
 }
 
+/*
+ * Parse shard in form I/N, where I is shard of this process, from 1 to N.
+ * Throws runtime_error if shard is not valid.
+ */
+void generator_parameters::set_shard(const std::string &shard) {
+
+    std::istringstream shard_stream(shard);
+    unsigned int index = 0, count = 0;
+    char separator = 0;
+
+    shard_stream >> index >> separator >> count;
+
+    if (shard_stream.fail() || !shard_stream.eof() || separator != '/' || count == 0 || index == 0 ||
+        index > count) {
+        std::ostringstream error_stream;
+        error_stream << "Invalid shard '" << shard << "'. Use --" << PARAM_SHARD
+                     << " I/N, where I is between 1 and N.";
+        throw std::runtime_error(error_stream.str());
+    }
+
+    this->shard_index = index - 1;
+    this->shard_count = count;
+}
+
+/*
+ * Parse log level: error, warn or info.
+ * Throws runtime_error if level is not valid.
+ */
+void generator_parameters::set_log_level(const std::string &level) {
+
+    if (level == LEVEL_ERROR) {
+        this->logging_level = log_level::ERROR;
+    } else if (level == LEVEL_WARN) {
+        this->logging_level = log_level::WARN;
+    } else if (level == LEVEL_INFO) {
+        this->logging_level = log_level::INFO;
+    } else {
+        std::ostringstream error_stream;
+        error_stream << "Invalid log level '" << level << "'. Use --" << PARAM_LOG_LEVEL << " " << LEVEL_ERROR
+                     << ", " << LEVEL_WARN << " or " << LEVEL_INFO << ".";
+        throw std::runtime_error(error_stream.str());
+    }
+}
+
+/*
+ * Parse log format: text or json.
+ * Throws runtime_error if format is not valid.
+ */
+void generator_parameters::set_log_format(const std::string &format) {
+
+    if (format == FORMAT_TEXT) {
+        this->logging_format = log_format::TEXT;
+    } else if (format == FORMAT_JSON) {
+        this->logging_format = log_format::JSON;
+    } else {
+        std::ostringstream error_stream;
+        error_stream << "Invalid log format '" << format << "'. Use --" << PARAM_LOG_FORMAT << " " << FORMAT_TEXT
+                     << " or " << FORMAT_JSON << ".";
+        throw std::runtime_error(error_stream.str());
+    }
+}
+
 /*
  * Go through all parameters and make sure they are valid
  */
@@ -61,29 +167,65 @@ void generator_parameters::validate_params() {
 
     std::ostringstream error_string_stream;
 
-    if (this->environment_files.empty()) {
-        error_string_stream << "No environment file specified. Use --" << PARAM_ENV << "." << std::endl;
-    }
-
     if (this->template_directory.length() > 0) {
         this->uses_directory = true;
     }
 
+    // --affected-by without outputs only queries the index, so it doesn't need environment or outputs
+    bool only_queries_index = !this->affected_variables.empty() && this->output_files.empty() &&
+                              !this->output_to_stdout && !this->only_check;
+
+    if (this->environment_files.empty() && !only_queries_index) {
+        error_string_stream << "No environment file specified. Use --" << PARAM_ENV << "." << std::endl;
+    }
+
     if (this->template_files.empty() && !this->uses_directory) {
-        error_string_stream << "No input files or directory specified. Use --" << PARAM_DIR << " or --" << PARAM_FILE
-                            << "." << std::endl;
+
+        // saved index can be queried without templates
+        if (!only_queries_index || this->index_file.empty()) {
+            error_string_stream << "No input files or directory specified. Use --" << PARAM_DIR << " or --"
+                                << PARAM_FILE << "." << std::endl;
+        }
     } else if (!this->template_files.empty() && this->uses_directory) {
         error_string_stream
                 << "Directory and files cannot be specified at once. Please only specify either --" << PARAM_FILE
                 << " or --" << PARAM_DIR << "." << std::endl;
     }
 
+    // shards are checked against a render in memory, outputs are optional
+    bool verifies_shards = !this->verified_shard_directories.empty();
+
+    if ((this->shard_count > 0 || verifies_shards) && !this->uses_directory) {
+        error_string_stream << "Shards can only be used with --" << PARAM_DIR << "." << std::endl;
+    }
+
+    if (this->shard_count > 0 && verifies_shards) {
+        error_string_stream << "Please only specify either --" << PARAM_SHARD << " or --" << PARAM_VERIFY_SHARDS
+                            << "." << std::endl;
+    }
+
+    // checking renders nothing, so outputs would never be written
+    if (this->only_check && (!this->output_files.empty() || this->output_to_stdout)) {
+        error_string_stream << "Check doesn't write any outputs. Please don't specify --" << PARAM_OUT << " or --"
+                            << PARAM_STDOUT << " with --" << PARAM_CHECK << "." << std::endl;
+    }
+
     // either specify outputs or stdout printout
-    if (this->output_files.empty() && !this->output_to_stdout) {
+    if (this->output_files.empty() && !this->output_to_stdout && !only_queries_index && !verifies_shards &&
+        !this->only_check) {
         error_string_stream << "No outputs specified. Use --" << PARAM_OUT << " or alternatively --" << PARAM_STDOUT
                             << "." << std::endl;
     }
 
+    // archive contains outputs under the names they would be written to
+    if (!this->archive_file.empty() && this->output_files.empty()) {
+        error_string_stream << "Archive needs outputs to name files in it. Use --" << PARAM_OUT << "." << std::endl;
+    }
+
+    if (this->compress_archive && this->archive_file.empty()) {
+        error_string_stream << "No archive to compress specified. Use --" << PARAM_ARCHIVE << "." << std::endl;
+    }
+
     // fail if number of outputs donesn't match with number of files, but only if outputs exist (otherwise stdout is used)
     if (!this->uses_directory && !this->output_files.empty()) {
 
@@ -96,7 +238,7 @@ void generator_parameters::validate_params() {
     }
 
     // set output directory
-    if (this->uses_directory) {
+    if (this->uses_directory && !this->output_files.empty()) {
         this->output_directory = this->output_files[0];
     }
 
@@ -114,14 +256,27 @@ void generator_parameters::get_params(int argc, char **argv) {
     int c;
 
     static struct option long_options[] = {
-            {PARAM_ENV.c_str(),            required_argument, nullptr, 0},
-            {PARAM_FILE.c_str(),           required_argument, nullptr, 0},
-            {PARAM_DIR.c_str(),            required_argument, nullptr, 0},
-            {PARAM_OUT.c_str(),            required_argument, nullptr, 0},
-            {PARAM_STDOUT.c_str(),         no_argument,       nullptr, 0},
-            {PARAM_DEFINER.c_str(),        required_argument, nullptr, 0},
-            {PARAM_CASE_SENSITIVE.c_str(), no_argument,       nullptr, 0},
-            {PARAM_HELP.c_str(),           no_argument,       nullptr, 0}
+            {PARAM_ENV.c_str(),              required_argument, nullptr, 0},
+            {PARAM_LAZY_ENV.c_str(),         no_argument,       nullptr, 0},
+            {PARAM_ENV_CACHE.c_str(),        required_argument, nullptr, 0},
+            {PARAM_FILE.c_str(),             required_argument, nullptr, 0},
+            {PARAM_DIR.c_str(),              required_argument, nullptr, 0},
+            {PARAM_OUT.c_str(),              required_argument, nullptr, 0},
+            {PARAM_STDOUT.c_str(),           no_argument,       nullptr, 0},
+            {PARAM_ARCHIVE.c_str(),          required_argument, nullptr, 0},
+            {PARAM_ARCHIVE_COMPRESS.c_str(), no_argument,       nullptr, 0},
+            {PARAM_DEFINER.c_str(),          required_argument, nullptr, 0},
+            {PARAM_CASE_SENSITIVE.c_str(),   no_argument,       nullptr, 0},
+            {PARAM_INDEX.c_str(),            required_argument, nullptr, 0},
+            {PARAM_AFFECTED_BY.c_str(),      required_argument, nullptr, 0},
+            {PARAM_SHARD.c_str(),            required_argument, nullptr, 0},
+            {PARAM_VERIFY_SHARDS.c_str(),    required_argument, nullptr, 0},
+            {PARAM_CHECK.c_str(),            no_argument,       nullptr, 0},
+            {PARAM_QUIET.c_str(),            no_argument,       nullptr, 0},
+            {PARAM_LOG_LEVEL.c_str(),        required_argument, nullptr, 0},
+            {PARAM_LOG_FORMAT.c_str(),       required_argument, nullptr, 0},
+            {PARAM_HELP.c_str(),             no_argument,       nullptr, 0},
+            {nullptr,                        0,                 nullptr, 0}
     };
 
     while (true) {
@@ -176,6 +331,10 @@ void generator_parameters::print_help() {
               << std::endl <<
               "If variables in files overlap, warnings will be issues, but the variable in latter file will take precedence."
               << std::endl <<
+              "``--lazy-env``: only read variables that templates use from environment files, using an index of them."
+              << std::endl <<
+              "``--env-cache``: directory to keep environment file indexes in between runs. Implies ``--lazy-env``."
+              << std::endl <<
               "``--file``: path to configuration file. You can specify more files by adding multiple ``-file`` flags."
               << std::endl <<
               "``--dir``: substitute all files in a directory." << std::endl
@@ -186,7 +345,34 @@ void generator_parameters::print_help() {
               "The inputs will be mapped to outputs based on the sequence." << std::endl <<
               std::endl <<
               "``--stdout``: instead of writing to file, output the result to stdout." << std::endl <<
-              "Can be used with ``-out`` to combine writing to files and priting to stdout." << std::endl << std::flush;
+              "Can be used with ``-out`` to combine writing to files and priting to stdout." << std::endl <<
+              std::endl <<
+              "``--archive``: write outputs into a single tar archive instead of separate files." << std::endl <<
+              "Files keep paths from ``--out`` inside of the archive." << std::endl <<
+              "``--archive-compress``: gzip compress the archive." << std::endl <<
+              std::endl <<
+              "``--index``: path to template dependency index. Rendering saves the index of variables used by templates."
+              << std::endl <<
+              "``--affected-by``: print templates that use the variable, from index or from --file/--dir. "
+              "Can be specified multiple times." << std::endl <<
+              "When outputs are specified as well, only affected templates are rendered." << std::endl <<
+              std::endl <<
+              "``--shard``: render only shard I of N of ``--dir``, such as 1/4. Files are assigned to shards by their"
+              << std::endl <<
+              "relative path, so they stay in their shard when other files change." << std::endl <<
+              "``--verify-shards``: output directory of a shard. Checks that all shards together equal a full render."
+              << std::endl <<
+              "Can be specified multiple times. If ``--out`` is specified as well, shards are merged into it."
+              << std::endl <<
+              std::endl <<
+              "``--check``: check templates for errors and undefined variables without rendering them." << std::endl <<
+              "Reports all errors and writes no outputs." << std::endl <<
+              std::endl <<
+              "``--log-level``: error, warn or info (default). Messages are written to stderr, outputs to stdout."
+              << std::endl <<
+              "``--quiet``: only log errors, same as ``--log-level error``." << std::endl <<
+              "``--log-format``: text (default) or json, which writes one json object per message." << std::endl
+              << std::flush;
 }
 
 /*
@@ -7,6 +7,7 @@
 
 #include <vector>
 #include <string>
+#include "logger.h"
 
 class generator_parameters {
 private:
@@ -20,9 +21,30 @@ private:
 
     bool output_to_stdout = false;
 
+    std::string archive_file;
+    bool compress_archive = false;
+
+    bool lazy_env = false;
+    std::string env_cache_directory;
+
     std::string definer = "%";
     bool is_case_sensitive = false;
 
+    std::string index_file;
+    std::vector<std::string> affected_variables;
+
+    // shard_count 0 means directory isn't sharded; shard_index is zero based
+    unsigned int shard_index = 0;
+    unsigned int shard_count = 0;
+    std::vector<std::string> verified_shard_directories;
+
+    // only check templates, without rendering or writing anything
+    bool only_check = false;
+
+    // diagnostics up to logging_level are written to stderr
+    log_level logging_level = log_level::INFO;
+    log_format logging_format = log_format::TEXT;
+
     bool display_help = true;
 
     friend class config_generator;
@@ -31,6 +53,12 @@ private:
 
     void set_argument(const std::string &argument_name, const std::string &argument_value);
 
+    void set_shard(const std::string &shard);
+
+    void set_log_level(const std::string &level);
+
+    void set_log_format(const std::string &format);
+
     static void print_help();
 
     void validate_params();
@@ -0,0 +1,213 @@
+#include <cstdio>
+#include "logger.h"
+
+namespace {
+
+    /*
+     * Buffer is handed to the background thread once it is this big.
+     */
+    const size_t BUFFER_SIZE = 64 * 1024;
+
+    const std::string_view ERROR_TAG = "[ERROR] ";
+
+    /*
+     * Buffer of one thread, which is handed to its logger when thread ends.
+     */
+    struct thread_log_buffer {
+        logger *owner = nullptr;
+        std::string text;
+
+        ~thread_log_buffer() {
+            if (this->owner != nullptr && !this->text.empty()) {
+                this->owner->submit(this->text);
+            }
+        }
+    };
+
+    thread_local thread_log_buffer log_buffer;
+}
+
+/*
+ * Write everything that was logged before logger is gone.
+ */
+logger::~logger() {
+
+    this->flush();
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->is_stopping = true;
+    }
+
+    this->buffers_available.notify_all();
+
+    if (this->sink.joinable()) {
+        this->sink.join();
+    }
+
+    if (log_buffer.owner == this) {
+        log_buffer.owner = nullptr;
+    }
+}
+
+void logger::configure(log_level configured_level, log_format configured_format) {
+    this->level = configured_level;
+    this->format = configured_format;
+}
+
+/*
+ * Buffer of calling thread, taken over from another logger if thread used one before.
+ */
+std::string &logger::thread_buffer() {
+
+    if (log_buffer.owner != this) {
+
+        if (log_buffer.owner != nullptr && !log_buffer.text.empty()) {
+            log_buffer.owner->submit(log_buffer.text);
+        }
+
+        log_buffer.owner = this;
+    }
+
+    return log_buffer.text;
+}
+
+void logger::begin_message(std::string &buffer, log_level message_level) const {
+
+    static const std::string_view TEXT_TAGS[] = {ERROR_TAG, "[WARN] ", ""};
+    static const std::string_view JSON_LEVELS[] = {"error", "warn", "info"};
+
+    if (this->format == log_format::JSON) {
+        buffer.append(R"({"level":")").append(JSON_LEVELS[static_cast<int>(message_level)]).append(R"(","message":")");
+    } else {
+        buffer.append(TEXT_TAGS[static_cast<int>(message_level)]);
+    }
+}
+
+/*
+ * End message and hand buffer over to the background thread if it is full.
+ * Errors are written before this returns, together with everything logged before them.
+ */
+void logger::end_message(std::string &buffer, log_level message_level) {
+
+    if (this->format == log_format::JSON) {
+        buffer.append("\"}");
+    }
+
+    buffer.push_back('\n');
+
+    if (message_level == log_level::ERROR) {
+        this->flush();
+    } else if (buffer.size() >= BUFFER_SIZE) {
+        this->submit(buffer);
+    }
+}
+
+/*
+ * Append text of message, escaped if messages are JSON.
+ */
+void logger::append_text(std::string &buffer, std::string_view text) const {
+
+    if (this->format != log_format::JSON) {
+        buffer.append(text);
+        return;
+    }
+
+    for (char character : text) {
+
+        switch (character) {
+            case '"':
+                buffer.append("\\\"");
+                break;
+            case '\\':
+                buffer.append("\\\\");
+                break;
+            case '\n':
+                buffer.append("\\n");
+                break;
+            case '\t':
+                buffer.append("\\t");
+                break;
+            case '\r':
+                buffer.append("\\r");
+                break;
+            default:
+
+                if (static_cast<unsigned char>(character) < 0x20) {
+                    static const char HEX_DIGITS[] = "0123456789abcdef";
+                    buffer.append("\\u00");
+                    buffer.push_back(HEX_DIGITS[character >> 4]);
+                    buffer.push_back(HEX_DIGITS[character & 0xf]);
+                } else {
+                    buffer.push_back(character);
+                }
+        }
+    }
+}
+
+/*
+ * Hand buffer over to the background thread, which is started with the first buffer, and clear it.
+ */
+void logger::submit(std::string &buffer) {
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        if (!this->sink.joinable()) {
+            this->sink = std::thread(&logger::write_buffers, this);
+        }
+
+        this->pending_buffers.push_back(std::move(buffer));
+    }
+
+    buffer.clear();
+    this->buffers_available.notify_one();
+}
+
+/*
+ * Background thread: write buffers to stderr as they come, until logger is stopped.
+ */
+void logger::write_buffers() {
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    std::vector<std::string> buffers;
+
+    while (true) {
+
+        this->buffers_available.wait(lock, [this] { return !this->pending_buffers.empty() || this->is_stopping; });
+
+        if (this->pending_buffers.empty()) return;
+
+        buffers.swap(this->pending_buffers);
+        this->is_writing = true;
+
+        lock.unlock();
+
+        for (const auto &buffer : buffers) {
+            std::fwrite(buffer.data(), 1, buffer.size(), stderr);
+        }
+
+        std::fflush(stderr);
+        buffers.clear();
+
+        lock.lock();
+
+        this->is_writing = false;
+        this->buffers_written.notify_all();
+    }
+}
+
+/*
+ * Submit buffer of calling thread and wait until everything submitted so far is written.
+ * Threads that have ended already submitted their buffers.
+ */
+void logger::flush() {
+
+    if (log_buffer.owner == this && !log_buffer.text.empty()) {
+        this->submit(log_buffer.text);
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    this->buffers_written.wait(lock, [this] { return this->pending_buffers.empty() && !this->is_writing; });
+}
@@ -0,0 +1,121 @@
+#ifndef CONFIG_GENERATOR_LOGGER_H
+#define CONFIG_GENERATOR_LOGGER_H
+
+#include <charconv>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/*
+ * Levels of log messages, from the most important one. Messages up to the configured level are written.
+ */
+enum class log_level : uint8_t {
+    ERROR,
+    WARN,
+    INFO
+};
+
+enum class log_format : uint8_t {
+    TEXT,
+    JSON
+};
+
+/*
+ * Diagnostics of program, written to stderr.
+ * Messages are formatted into a buffer of the thread that logs them, and full buffers are written by a background
+ * thread, so that logging neither flushes per message nor makes threads wait for each other on the stream.
+ * Errors are written before error() returns, so that they aren't lost if the program doesn't end normally.
+ * Messages of one thread stay in order; messages of different threads are only ordered by when buffers fill up.
+ * Disabled levels are checked before anything is formatted.
+ */
+class logger {
+
+private:
+    log_level level = log_level::INFO;
+    log_format format = log_format::TEXT;
+
+    std::mutex mutex;
+    std::condition_variable buffers_available;
+    std::condition_variable buffers_written;
+    std::vector<std::string> pending_buffers;
+    std::thread sink;
+    bool is_writing = false;
+    bool is_stopping = false;
+
+    std::string &thread_buffer();
+
+    void begin_message(std::string &buffer, log_level message_level) const;
+
+    void end_message(std::string &buffer, log_level message_level);
+
+    void append_text(std::string &buffer, std::string_view text) const;
+
+    template<typename PART>
+    void append_part(std::string &buffer, const PART &part) const {
+
+        if constexpr (std::is_arithmetic_v<PART>) {
+            char digits[24];
+            auto result = std::to_chars(digits, digits + sizeof(digits), part);
+            buffer.append(digits, result.ptr);
+        } else if constexpr (std::is_base_of_v<std::exception, PART>) {
+            this->append_text(buffer, part.what());
+        } else {
+            this->append_text(buffer, std::string_view(part));
+        }
+    }
+
+    template<typename... PARTS>
+    void log(log_level message_level, const PARTS &... parts) {
+
+        if (!this->is_enabled(message_level)) return;
+
+        std::string &buffer = this->thread_buffer();
+
+        this->begin_message(buffer, message_level);
+        (this->append_part(buffer, parts), ...);
+        this->end_message(buffer, message_level);
+    }
+
+    void write_buffers();
+
+public:
+    logger() = default;
+
+    logger(const logger &) = delete;
+
+    logger &operator=(const logger &) = delete;
+
+    ~logger();
+
+    void configure(log_level configured_level, log_format configured_format);
+
+    bool is_enabled(log_level message_level) const {
+        return message_level <= this->level;
+    }
+
+    /*
+     * Log message made of parts, which are strings, numbers or exceptions, such as
+     * error("File ", path, " doesn't exist.").
+     */
+    template<typename... PARTS>
+    void error(const PARTS &... parts) { this->log(log_level::ERROR, parts...); }
+
+    template<typename... PARTS>
+    void warn(const PARTS &... parts) { this->log(log_level::WARN, parts...); }
+
+    template<typename... PARTS>
+    void info(const PARTS &... parts) { this->log(log_level::INFO, parts...); }
+
+    void submit(std::string &buffer);
+
+    void flush();
+};
+
+
+#endif //CONFIG_GENERATOR_LOGGER_H
@@ -0,0 +1,8 @@
+#include "output_buffer.h"
+
+/*
+ * Write whole buffer to stream at once, without formatting or copying it.
+ */
+void output_buffer::write_to(std::ostream &stream) const {
+    stream.write(this->buffer.data(), static_cast<std::streamsize>(this->buffer.size()));
+}
@@ -0,0 +1,50 @@
+#ifndef CONFIG_GENERATOR_OUTPUT_BUFFER_H
+#define CONFIG_GENERATOR_OUTPUT_BUFFER_H
+
+#include <string>
+#include <string_view>
+#include <ostream>
+
+/*
+ * Caller owned buffer that a render writes generated file into.
+ * Clearing the buffer keeps its capacity, so a buffer that is reused across renders
+ * stops allocating once it has grown to the size of the largest generated file.
+ * Buffer is move-only, so that generated output is never copied by accident.
+ */
+class output_buffer {
+
+private:
+    std::string buffer;
+
+public:
+    output_buffer() = default;
+
+    output_buffer(const output_buffer &) = delete;
+
+    output_buffer &operator=(const output_buffer &) = delete;
+
+    output_buffer(output_buffer &&) noexcept = default;
+
+    output_buffer &operator=(output_buffer &&) noexcept = default;
+
+    void clear() { this->buffer.clear(); }
+
+    void reserve(size_t capacity) { this->buffer.reserve(capacity); }
+
+    void append(std::string_view text) { this->buffer.append(text.data(), text.size()); }
+
+    void append(char character) { this->buffer.push_back(character); }
+
+    std::string_view view() const { return this->buffer; }
+
+    const char *data() const { return this->buffer.data(); }
+
+    size_t size() const { return this->buffer.size(); }
+
+    size_t capacity() const { return this->buffer.capacity(); }
+
+    void write_to(std::ostream &stream) const;
+};
+
+
+#endif //CONFIG_GENERATOR_OUTPUT_BUFFER_H
@@ -9,8 +9,7 @@
 #include <sstream>
 #include <vector>
 #include <tuple>
-#include <unordered_map>
-#include <regex>
+#include <string_view>
 #include "string_utils.h"
 
 /*
@@ -20,13 +19,14 @@ namespace parsing_utils {
 
     const std::string LOGICAL_AND = "AND", LOGICAL_OR = "OR";
     const std::string CONDITIONAL_IS = "IS", CONDITIONAL_IS_NOT = "IS_NOT";
-    const std::string IF_STATEMENT = "IF", ENDIF_STATEMENT = "ENDIF";
+    const std::string IF_STATEMENT = "IF", ENDIF_STATEMENT = "ENDIF", INCLUDE_STATEMENT = "INCLUDE";
+    const std::string FOR_STATEMENT = "FOR", ENDFOR_STATEMENT = "ENDFOR", FOR_IN = "IN";
 
     /*
      * Take a string, such as A=3 and return pair <name, value>
      * Throws runtime_error
      */
-    std::pair<std::string, std::string> get_name_value_pair(const std::string &env_line, char equal_sign = '=') {
+    inline std::pair<std::string, std::string> get_name_value_pair(const std::string &env_line, char equal_sign = '=') {
 
         std::ostringstream error_stream;
 
@@ -71,23 +71,41 @@ namespace parsing_utils {
         return name_and_value_pair;
     }
 
+    /*
+     * Checks if line contains definer immediately followed by keyword (such as %IF) anywhere.
+     */
+    inline bool line_contains_statement(std::string_view line, std::string_view definer, std::string_view keyword) {
+
+        for (size_t pos = line.find(definer); pos != std::string_view::npos; pos = line.find(definer, pos + 1)) {
+
+            if (line.substr(pos + definer.size(), keyword.size()) == keyword) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
     /*
      * Checks if a line is an if statement.
      * Line is an if statement if it begins with if identifier, such as %IF.
      * Function expects string to be trimmed.
      * Throws runtime_error if line contains if but it doesn't start with it.
      */
-    bool is_line_if_statement(const std::string &line, const std::string &definer) {
+    inline bool is_line_if_statement(std::string_view line, std::string_view definer) {
 
-        std::string if_statement_identifier = definer + IF_STATEMENT;
+        size_t if_end = definer.size() + IF_STATEMENT.size();
 
-        bool line_begins_with_if = line.rfind(if_statement_identifier + " ") == 0;
+        bool line_begins_with_if = line.size() > if_end && line[if_end] == ' ' &&
+                                   line.substr(0, definer.size()) == definer &&
+                                   line.substr(definer.size(), IF_STATEMENT.size()) == IF_STATEMENT;
 
         if (line_begins_with_if) {
             return true;
-        } else if (line.find(if_statement_identifier) != std::string::npos) {
+        } else if (line_contains_statement(line, definer, IF_STATEMENT)) {
             std::ostringstream error_stream;
-            error_stream << "If line '" << line << "' doesn't have " << if_statement_identifier << " at the beginning.";
+            error_stream << "If line '" << line << "' doesn't have " << definer << IF_STATEMENT
+                         << " at the beginning.";
             throw std::runtime_error(error_stream.str());
         }
 
@@ -100,29 +118,67 @@ namespace parsing_utils {
      * Function expects string to be trimmed.
      * Throws runtime_error if line contains endif but it isn't the only thing in the line.
      */
-    bool is_line_endif_statement(const std::string &line, const std::string &definer) {
+    inline bool is_line_endif_statement(std::string_view line, std::string_view definer) {
 
-        std::string endif_statement_identifier = definer + ENDIF_STATEMENT;
-
-        bool line_is_exactly_endif = line == endif_statement_identifier;
+        bool line_is_exactly_endif = line.size() == definer.size() + ENDIF_STATEMENT.size() &&
+                                     line.substr(0, definer.size()) == definer &&
+                                     line.substr(definer.size()) == ENDIF_STATEMENT;
 
         if (line_is_exactly_endif) {
             return true;
-        } else if (line.find(endif_statement_identifier) != std::string::npos) {
+        } else if (line_contains_statement(line, definer, ENDIF_STATEMENT)) {
             std::ostringstream error_stream;
             error_stream << "Endif line '" << line << "' contains additional text. Endif lines should contain only "
-                         << endif_statement_identifier << ".";
+                         << definer << ENDIF_STATEMENT << ".";
+            throw std::runtime_error(error_stream.str());
+        }
+
+        return false;
+    }
+
+    /*
+     * Checks if a line is an include statement, such as %INCLUDE partials/tls.conf, and sets path
+     * to the included path.
+     * Function expects string to be trimmed.
+     * Throws runtime_error if line contains include but it doesn't start with it or has no path.
+     */
+    inline bool is_line_include_statement(std::string_view line, std::string_view definer, std::string_view &path) {
+
+        size_t include_end = definer.size() + INCLUDE_STATEMENT.size();
+
+        bool line_begins_with_include = line.size() > include_end && line[include_end] == ' ' &&
+                                        line.substr(0, definer.size()) == definer &&
+                                        line.substr(definer.size(), INCLUDE_STATEMENT.size()) == INCLUDE_STATEMENT;
+
+        if (line_begins_with_include) {
+            path = string_utils::trim_view(line.substr(include_end));
+            return true;
+        } else if (line_contains_statement(line, definer, INCLUDE_STATEMENT)) {
+            std::ostringstream error_stream;
+            error_stream << "Include line '" << line << "' should only contain " << definer << INCLUDE_STATEMENT
+                         << " followed by path of included file.";
             throw std::runtime_error(error_stream.str());
         }
 
         return false;
     }
 
+    /*
+     * Checks if line starts with statement keyword (such as %FOR), followed by space or nothing.
+     */
+    inline bool line_starts_with_statement(std::string_view line, std::string_view definer, std::string_view keyword) {
+
+        size_t keyword_end = definer.size() + keyword.size();
+
+        return line.size() >= keyword_end && (line.size() == keyword_end || line[keyword_end] == ' ') &&
+               line.substr(0, definer.size()) == definer && line.substr(definer.size(), keyword.size()) == keyword;
+    }
+
     /*
      * Returns val right_side logical_operator left_side
      * Throws runtime_error if invalid logical operator
      */
-    bool evaluate_logical_operator(bool left_side, const std::string &logical_operator, bool right_side) {
+    inline bool evaluate_logical_operator(bool left_side, std::string_view logical_operator, bool right_side) {
 
         if (logical_operator == LOGICAL_AND) {
             return left_side && right_side;
@@ -139,23 +195,24 @@ namespace parsing_utils {
      * Returns val right_side logical_operator left_side
      * Throws runtime_error if invalid conditional operator
      */
-    bool evaluate_conditional_operator(const std::string &left_side, const std::string &conditional_operator,
-                                       const std::string &right_side, bool case_sensitive = false) {
+    template<bool CASE_SENSITIVE>
+    bool evaluate_conditional_operator(std::string_view left_side, std::string_view conditional_operator,
+                                       std::string_view right_side) {
 
         if (conditional_operator == CONDITIONAL_IS) {
 
-            if (case_sensitive) {
-                return string_utils::compare_case_insensitive(left_side, right_side);
-            } else {
+            if constexpr (CASE_SENSITIVE) {
                 return left_side == right_side;
+            } else {
+                return string_utils::compare_case_insensitive(left_side, right_side);
             }
 
         } else if (conditional_operator == CONDITIONAL_IS_NOT) {
 
-            if (case_sensitive) {
-                return !string_utils::compare_case_insensitive(left_side, right_side);
-            } else {
+            if constexpr (CASE_SENSITIVE) {
                 return left_side != right_side;
+            } else {
+                return !string_utils::compare_case_insensitive(left_side, right_side);
             }
         }
 
@@ -165,67 +222,64 @@ namespace parsing_utils {
     }
 
     /*
-     * Evaluate line that is considered an if statement. If line isn't an if statement, return true.
-     * Function assumes variables are already replaced and that string is trimmed!
-     * Eg. %IF DEVELOPMENT IS DEVELOPMENT will work, but %IF %{MODE} IS DEVELOPMENT wont!
-     * Throws runtime_error for syntax errors
+     * Take the next space separated word of line, starting at position, and move position past it.
+     * Consecutive spaces produce empty words, the same way std::getline with ' ' delimiter does.
      */
-    bool evaluate_if_statement_line(const std::string &line, const std::string &definer, bool case_sensitive) {
+    inline std::string_view next_word(std::string_view line, size_t &position) {
 
-        // evaluate non if statements as "true"
-        if (!is_line_if_statement(line, definer)) {
-            return true;
+        size_t word_end = line.find(' ', position);
+
+        if (word_end == std::string_view::npos) {
+            word_end = line.size();
         }
 
-        // split whole line by spaces
-        std::vector<std::string> line_split_by_spaces;
+        std::string_view word = line.substr(position, word_end - position);
+        position = word_end + 1;
 
-        std::stringstream ss(line);
-        std::string token;
-        while (std::getline(ss, token, ' ')) {
+        return word;
+    }
 
-            line_split_by_spaces.push_back(token);
-        }
+    /*
+     * Evaluate words of if statement line, such as %IF A IS B AND C IS_NOT D.
+     * Function assumes line is an if statement, variables are already replaced and that string is trimmed!
+     * Throws runtime_error for syntax errors
+     */
+    template<bool CASE_SENSITIVE>
+    bool evaluate_if_statement_words(std::string_view line) {
 
-        // should not happen
-        if (line_split_by_spaces.empty()) {
-            return true;
-        }
+        // words are separated by single spaces, so there is one more word than there are spaces
+        unsigned long word_count = std::count(line.begin(), line.end(), ' ') + 1;
 
         // subcondition -> one sub condition in whole if statement (separated by logical operators)
         // eg. IF A IS B -> 4 words
         // or  AND B IS C -> 4 words
         const int WORDS_IN_IF_SUBCONDITION = 4;
 
-        if (line_split_by_spaces.size() % WORDS_IN_IF_SUBCONDITION != 0) {
+        if (word_count % WORDS_IN_IF_SUBCONDITION != 0) {
             std::ostringstream error_stream;
             error_stream << "If line '" << line
                          << "' has invalid amount of words (expected 4, 8, 12, ..., but got "
-                         << line_split_by_spaces.size() << ".";
+                         << word_count << ".";
             throw std::runtime_error(error_stream.str());
         }
 
         bool final_if_statement_value = false;
+        size_t position = 0;
 
-        // iterate vector as 2D array, so i will jump by one, but it actually jumps by WORDS_IN_IF_LINE.
-        for (unsigned long i = 0; i < line_split_by_spaces.size() / WORDS_IN_IF_SUBCONDITION; i++) {
-
-            std::string current_logical_operator;
+        // walk the words one subcondition (WORDS_IN_IF_SUBCONDITION words) at a time
+        for (unsigned long i = 0; i < word_count / WORDS_IN_IF_SUBCONDITION; i++) {
 
-            // if we are in second if substatement, because first one contains IF word
-            if (i > 0) {
+            // first subcondition starts with IF word instead of logical operator
+            std::string_view current_logical_operator = next_word(line, position);
 
-                current_logical_operator = line_split_by_spaces[i * WORDS_IN_IF_SUBCONDITION];
-            }
-
-            // get other values in this if statement by pseudo 2D array indexing
-            std::string left_val = line_split_by_spaces[i * WORDS_IN_IF_SUBCONDITION + 1];
-            std::string conditional_operator = line_split_by_spaces[i * WORDS_IN_IF_SUBCONDITION + 2];
-            std::string right_val = line_split_by_spaces[i * WORDS_IN_IF_SUBCONDITION + 3];
+            std::string_view left_val = next_word(line, position);
+            std::string_view conditional_operator = next_word(line, position);
+            std::string_view right_val = next_word(line, position);
 
             // evaluate this statement
-            bool current_statement_value = evaluate_conditional_operator(left_val, conditional_operator, right_val,
-                                                                         case_sensitive);
+            bool current_statement_value = evaluate_conditional_operator<CASE_SENSITIVE>(left_val,
+                                                                                         conditional_operator,
+                                                                                         right_val);
 
             if (i == 0) {
 
@@ -245,50 +299,91 @@ namespace parsing_utils {
     }
 
     /*
-     * Substitutes any variables in the line, using the dictionary provided (env_var_dictionary).
-     * Uses definer with curly braces to replace variables.
-     * For example %{HELLO} will be replaces with whatever HELLO points to in env_var_dictionary.
-     * Throws runtime_error if HELLO doesn't exist in env_var_dictionary.
-     * If variable is empty (%{}), then throw error as well.
+     * Find next variable with given pattern %{...} in line, starting at position.
+     * On success, variable_start points to definer and name_end to closing curly brace.
+     * Unterminated variables (%{ without }) are not variables.
      */
-    std::string substitute_vars(std::string line, const std::string &definer,
-                                std::unordered_map<std::string, std::string> &env_var_dictionary) {
+    inline bool find_variable(std::string_view line, std::string_view definer, size_t position,
+                              size_t &variable_start, size_t &name_end) {
 
-        std::ostringstream error_stream;
+        variable_start = line.find(definer, position);
 
-        // define regex for finding variables with given pattern %{...}
-        std::regex var_pattern(definer + "\\{(.*?)\\}");
+        while (variable_start != std::string_view::npos &&
+               (variable_start + definer.size() >= line.size() || line[variable_start + definer.size()] != '{')) {
+            variable_start = line.find(definer, variable_start + 1);
+        }
 
-        std::smatch match_result;
-        std::string substituted_line = line;
+        if (variable_start == std::string_view::npos) return false;
 
-        while (std::regex_search(line, match_result, var_pattern)) {
+        name_end = line.find('}', variable_start + definer.size() + 1);
 
-            // there should be exactly 2 results, but check anyway
-            if (match_result.size() >= 2) {
+        return name_end != std::string_view::npos;
+    }
 
-                std::string variable_name = match_result[1].str();
+    /*
+     * Checks if a line is a for statement, such as %FOR BACKEND IN %{BACKENDS}, and sets loop_variable to name
+     * of variable that takes each item (BACKEND) and list_variable to name of list variable (BACKENDS).
+     * Function expects string to be trimmed.
+     * Throws runtime_error if line starts with for, but isn't a valid for statement.
+     */
+    inline bool is_line_for_statement(std::string_view line, std::string_view definer,
+                                      std::string_view &loop_variable, std::string_view &list_variable) {
 
-                if (variable_name.empty()) {
-                    error_stream << "Empty variable.";
-                    throw std::runtime_error(error_stream.str());
-                } else if (env_var_dictionary.find(variable_name) == env_var_dictionary.end()) {
-                    error_stream << "Undefined variable " << variable_name << ".";
-                    throw std::runtime_error(error_stream.str());
-                }
+        if (!line_starts_with_statement(line, definer, FOR_STATEMENT)) {
+            return false;
+        }
 
-                std::string unsubstituted_variable = match_result[0].str();
+        size_t position = 0;
+        std::string_view words[4];
 
-                // in line that will be returned, replace the original variable (%{...}) with value, found in dictionary
-                substituted_line = string_utils::replace(substituted_line, unsubstituted_variable,
-                                                         env_var_dictionary[variable_name]);
-            }
+        for (auto &word : words) {
+            word = position <= line.size() ? next_word(line, position) : std::string_view();
+        }
+
+        // list is exactly one variable, %{LIST}
+        size_t variable_start = 0, name_end = 0;
+
+        bool is_list_variable = find_variable(words[3], definer, 0, variable_start, name_end) &&
+                                variable_start == 0 && name_end == words[3].size() - 1 &&
+                                name_end > definer.size() + 1;
+
+        // loop variable is a plain name, used as %{NAME} in the loop
+        bool is_loop_variable = !words[1].empty() && words[1].find(definer) == std::string_view::npos &&
+                                words[1].find_first_of("{}") == std::string_view::npos;
+
+        if (position <= line.size() || !is_loop_variable || words[2] != FOR_IN || !is_list_variable) {
+            std::ostringstream error_stream;
+            error_stream << "For line '" << line << "' should be " << definer << FOR_STATEMENT << " NAME " << FOR_IN
+                         << " " << definer << "{LIST}.";
+            throw std::runtime_error(error_stream.str());
+        }
 
-            // update line
-            line = match_result.suffix().str();
+        loop_variable = words[1];
+        list_variable = words[3].substr(definer.size() + 1, name_end - definer.size() - 1);
+
+        return true;
+    }
+
+    /*
+     * Checks if a line is an endfor statement.
+     * Line is an endfor statement if it only contains an endfor identifier, such as %ENDFOR.
+     * Function expects string to be trimmed.
+     * Throws runtime_error if line starts with endfor, but has additional text.
+     */
+    inline bool is_line_endfor_statement(std::string_view line, std::string_view definer) {
+
+        if (!line_starts_with_statement(line, definer, ENDFOR_STATEMENT)) {
+            return false;
+        }
+
+        if (line.size() > definer.size() + ENDFOR_STATEMENT.size()) {
+            std::ostringstream error_stream;
+            error_stream << "Endfor line '" << line << "' contains additional text. Endfor lines should contain only "
+                         << definer << ENDFOR_STATEMENT << ".";
+            throw std::runtime_error(error_stream.str());
         }
 
-        return substituted_line;
+        return true;
     }
 }
 
@@ -0,0 +1,70 @@
+#include <climits>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include "partial_cache.h"
+#include "file_utils.h"
+
+partial_cache::partial_cache(std::string definer) : definer(std::move(definer)) {
+    this->compile = compiled_template::select_compile_kernel(this->definer);
+}
+
+/*
+ * Return partial included from file including_file_path. Relative include paths are relative to
+ * directory of including file. Partial is read and compiled the first time it is included.
+ * Throws runtime_error if partial doesn't exist.
+ */
+const partial_template &partial_cache::get(const std::string &including_file_path, std::string_view include_path) {
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    this->resolved_path.clear();
+
+    if (include_path.empty() || include_path[0] != '/') {
+
+        size_t directory_end = including_file_path.rfind('/');
+
+        if (directory_end != std::string::npos) {
+            this->resolved_path.append(including_file_path, 0, directory_end + 1);
+        }
+    }
+
+    this->resolved_path.append(include_path.data(), include_path.size());
+
+    auto resolved = this->resolved_paths.find(this->resolved_path);
+
+    if (resolved != this->resolved_paths.end()) {
+        return *resolved->second;
+    }
+
+    char canonical_path[PATH_MAX];
+
+    if (realpath(this->resolved_path.c_str(), canonical_path) == nullptr) {
+        std::ostringstream error_stream;
+        error_stream << "Included file " << this->resolved_path << " doesn't exist.";
+        throw std::runtime_error(error_stream.str());
+    }
+
+    std::unique_ptr<partial_template> &partial = this->partials[canonical_path];
+
+    if (!partial) {
+
+        std::string partial_source;
+
+        if (!file_utils::read_file(canonical_path, partial_source)) {
+            this->partials.erase(canonical_path);
+
+            std::ostringstream error_stream;
+            error_stream << "Included file " << this->resolved_path << " can't be read.";
+            throw std::runtime_error(error_stream.str());
+        }
+
+        partial = std::make_unique<partial_template>();
+        partial->file_path = canonical_path;
+        this->compile(partial_source, this->definer, partial->compiled);
+    }
+
+    this->resolved_paths.emplace(this->resolved_path, partial.get());
+
+    return *partial;
+}
@@ -0,0 +1,52 @@
+#ifndef CONFIG_GENERATOR_PARTIAL_CACHE_H
+#define CONFIG_GENERATOR_PARTIAL_CACHE_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "compiled_template.h"
+
+/*
+ * Template included with %INCLUDE, compiled once.
+ */
+struct partial_template {
+
+    // canonical path, so that the same file included by different paths is one partial
+    std::string file_path;
+    compiled_template compiled;
+};
+
+/*
+ * Cache of included templates, shared by every template that includes them, so that each partial
+ * is read and compiled only once per process, no matter how many times it is included.
+ * Partials are never removed, so references to them stay valid for as long as the cache exists.
+ */
+class partial_cache {
+
+private:
+    std::string definer;
+    compiled_template::compile_kernel compile;
+
+    std::mutex mutex;
+
+    // canonical path -> partial
+    std::unordered_map<std::string, std::unique_ptr<partial_template>> partials;
+
+    // path as written, joined with directory of including file -> partial
+    std::unordered_map<std::string, const partial_template *> resolved_paths;
+    std::string resolved_path;
+
+public:
+    explicit partial_cache(std::string definer);
+
+    partial_cache(const partial_cache &) = delete;
+
+    partial_cache &operator=(const partial_cache &) = delete;
+
+    const partial_template &get(const std::string &including_file_path, std::string_view include_path);
+};
+
+
+#endif //CONFIG_GENERATOR_PARTIAL_CACHE_H
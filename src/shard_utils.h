@@ -0,0 +1,67 @@
+#ifndef CONFIG_GENERATOR_SHARD_UTILS_H
+#define CONFIG_GENERATOR_SHARD_UTILS_H
+
+#include <cstdint>
+#include <string_view>
+
+/*
+ * Utilities for splitting directory render between several processes or machines
+ */
+namespace shard_utils {
+
+    /*
+     * FNV-1a hash of path, which is the same on every machine and every run.
+     */
+    inline uint64_t path_hash(std::string_view path) {
+
+        uint64_t hash = 14695981039346656037ULL;
+
+        for (char character : path) {
+            hash ^= static_cast<unsigned char>(character);
+            hash *= 1099511628211ULL;
+        }
+
+        return hash;
+    }
+
+    /*
+     * Score of shard for path hash, uniformly distributed and independent between shards (splitmix64 finalizer).
+     */
+    inline uint64_t shard_score(uint64_t hash, unsigned int shard) {
+
+        uint64_t score = hash ^ ((shard + 1) * 0x9E3779B97F4A7C15ULL);
+
+        score = (score ^ (score >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        score = (score ^ (score >> 27)) * 0x94D049BB133111EBULL;
+
+        return score ^ (score >> 31);
+    }
+
+    /*
+     * Shard of file, out of shard_count shards, by rendezvous hashing of its relative path:
+     * file belongs to the shard with the highest score for its path.
+     * Shard only depends on the path itself, so adding, removing or resizing other files never moves it,
+     * and processes that see slightly different trees still agree on every file they both see.
+     */
+    inline unsigned int file_shard(std::string_view relative_path, unsigned int shard_count) {
+
+        uint64_t hash = path_hash(relative_path);
+
+        unsigned int best_shard = 0;
+        uint64_t best_score = shard_score(hash, 0);
+
+        for (unsigned int shard = 1; shard < shard_count; shard++) {
+
+            uint64_t score = shard_score(hash, shard);
+
+            if (score > best_score) {
+                best_shard = shard;
+                best_score = score;
+            }
+        }
+
+        return best_shard;
+    }
+}
+
+#endif //CONFIG_GENERATOR_SHARD_UTILS_H
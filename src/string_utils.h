@@ -6,6 +6,10 @@
 #define CONFIG_GENERATOR_STRING_UTILS_H
 
 #include <string>
+#include <string_view>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 
 /*
  * Utilities for working with strings
@@ -15,7 +19,7 @@ namespace string_utils {
     /*
      * Trim string from left side
      */
-    std::string left_trim(const std::string &str, const std::string &chars = "\t\n\v\f\r ") {
+    inline std::string left_trim(const std::string &str, const std::string &chars = "\t\n\v\f\r ") {
 
         if (str.empty()) return str;
 
@@ -36,19 +40,19 @@ namespace string_utils {
     /*
      * Trim string from right side
      */
-    std::string right_trim(const std::string &str, const std::string &chars = "\t\n\v\f\r ") {
+    inline std::string right_trim(const std::string &str, const std::string &chars = "\t\n\v\f\r ") {
 
         if (str.empty()) return str;
 
         unsigned long i;
-        for (i = str.length() - 1; i >= 0; i--) {
+        for (i = str.length(); i > 0; i--) {
 
             // keep checking until one character is not a trimming character
-            if (chars.find(str[i]) == std::string::npos) break;
+            if (chars.find(str[i - 1]) == std::string::npos) break;
         }
 
-        if (i < str.length() - 1) {
-            return str.substr(0, i + 1);
+        if (i < str.length()) {
+            return str.substr(0, i);
         }
 
         return str;
@@ -57,18 +61,33 @@ namespace string_utils {
     /*
      * Trim string from both sides
      */
-    std::string trim(const std::string &str, const std::string &chars = "\t\n\v\f\r ") {
+    inline std::string trim(const std::string &str, const std::string &chars = "\t\n\v\f\r ") {
         std::string right_trimmed = right_trim(str, chars);
         return left_trim(right_trimmed, chars);
     }
 
+    /*
+     * Trim string from both sides without copying it.
+     * Returned view points into str, so str must outlive it.
+     */
+    inline std::string_view trim_view(std::string_view str, std::string_view chars = "\t\n\v\f\r ") {
+
+        size_t begin = str.find_first_not_of(chars);
+
+        if (begin == std::string_view::npos) return str.substr(0, 0);
+
+        size_t end = str.find_last_not_of(chars);
+
+        return str.substr(begin, end - begin + 1);
+    }
+
     /*
      * Searches string for a value.
      * If it finds a character not exactly for exact_count amount, returns false
      * Otherwise, returns true
      * char_count_max_exact is used to return the information about
      */
-    int count_char(const std::string &str, char search_char) {
+    inline int count_char(const std::string &str, char search_char) {
 
         int char_count = 0;
 
@@ -85,7 +104,7 @@ namespace string_utils {
     /*
      * Replace str from search with replace (only first occurence)
      */
-    std::string replace(std::string &str, const std::string &search, const std::string &replace) {
+    inline std::string replace(std::string &str, const std::string &search, const std::string &replace) {
 
         size_t start_pos = str.find(search);
         if (start_pos == std::string::npos)
@@ -96,14 +115,70 @@ namespace string_utils {
         return replaced_string;
     }
 
+    /*
+     * Lowercase ASCII letters in all 8 characters of word at once.
+     * Sets 0x20 bit in every byte that is between 'A' and 'Z'; other bytes, including non ASCII, are kept.
+     */
+    inline uint64_t fold_ascii_word(uint64_t word) {
+
+        const uint64_t ONES = 0x0101010101010101ULL, HIGH_BITS = 0x8080808080808080ULL;
+
+        uint64_t low_bits = word & ~HIGH_BITS;
+
+        // high bit of each byte is set if byte is at least 'A', or more than 'Z'
+        uint64_t at_least_a = low_bits + ONES * (0x80 - 'A');
+        uint64_t more_than_z = low_bits + ONES * (0x7f - 'Z');
+
+        uint64_t is_upper = (at_least_a ^ more_than_z) & ~word & HIGH_BITS;
+
+        return word | (is_upper >> 2);
+    }
+
+    /*
+     * Lowercase ASCII letter, keep any other character.
+     */
+    inline char fold_ascii_char(char character) {
+        return character >= 'A' && character <= 'Z' ? static_cast<char>(character - 'A' + 'a') : character;
+    }
+
+    /*
+     * Return copy of string with ASCII letters in lowercase, for comparing without looking at case.
+     */
+    inline std::string fold_ascii(std::string_view str) {
+
+        std::string folded(str);
+
+        for (char &character : folded) {
+            character = fold_ascii_char(character);
+        }
+
+        return folded;
+    }
+
     /*
      * Compare two strings without looking at case of characters.
+     * Strings of different length are never equal; others are compared 8 characters at a time.
      */
-    bool compare_case_insensitive(const std::string &str1, const std::string &str2) {
-        return std::equal(str1.begin(), str1.end(), str2.begin(),
-                          [](const char &a, const char &b) {
-                              return (std::tolower(a) == std::tolower(b));
-                          });
+    inline bool compare_case_insensitive(std::string_view str1, std::string_view str2) {
+
+        if (str1.size() != str2.size()) return false;
+
+        size_t i = 0;
+
+        for (; i + sizeof(uint64_t) <= str1.size(); i += sizeof(uint64_t)) {
+
+            uint64_t word1, word2;
+            std::memcpy(&word1, str1.data() + i, sizeof(uint64_t));
+            std::memcpy(&word2, str2.data() + i, sizeof(uint64_t));
+
+            if (word1 != word2 && fold_ascii_word(word1) != fold_ascii_word(word2)) return false;
+        }
+
+        for (; i < str1.size(); i++) {
+            if (fold_ascii_char(str1[i]) != fold_ascii_char(str2[i])) return false;
+        }
+
+        return true;
     }
 }
 
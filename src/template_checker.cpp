@@ -0,0 +1,400 @@
+#include <algorithm>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include "template_checker.h"
+#include "string_utils.h"
+#include "parsing_utils.h"
+#include "thread_utils.h"
+#include "file_utils.h"
+
+namespace {
+
+    const std::string EXPECTED_ENDIF = "Expected endif (check if every if statement has a corresponding endif)";
+
+    // value of loop variables whose list can't be checked, and of loop variables in included templates
+    const env_value LOOP_ITEM("item");
+
+    std::string located_error(const std::string &file_path, int line_number, const std::string &error) {
+        std::ostringstream error_stream;
+        error_stream << "File: " << file_path << ", line: " << line_number << ": " << error;
+        return error_stream.str();
+    }
+}
+
+template_checker::template_checker(std::string definer, const env_dictionary &env_var_dictionary,
+                                   partial_cache &partials)
+        : definer(std::move(definer)), env_var_dictionary(&env_var_dictionary), partials(&partials) {
+
+    this->compile = compiled_template::select_compile_kernel(this->definer);
+}
+
+/*
+ * Look up every variable of template once.
+ * Included templates can use loop variables of templates that include them, so those are defined in partials.
+ */
+void template_checker::resolve_variables(const compiled_template &compiled, bool is_partial,
+                                         check_scratch &scratch) const {
+
+    scratch.variable_values.clear();
+
+    for (const auto &variable : compiled.variables) {
+
+        std::string_view name = compiled.segment_text(variable);
+        scratch.variable_name.assign(name.data(), name.size());
+
+        const env_value *value = this->env_var_dictionary->find_evaluated(scratch.variable_name);
+
+        if (value == nullptr && is_partial && this->loop_variable_names.count(scratch.variable_name) > 0) {
+            value = &LOOP_ITEM;
+        }
+
+        scratch.variable_values.push_back(value);
+    }
+}
+
+/*
+ * Report every undefined variable of line.
+ */
+void template_checker::check_variables(const compiled_template &compiled, const template_line &line,
+                                       const std::string &file_path, const check_scratch &scratch,
+                                       checked_template &checked) const {
+
+    for (uint32_t i = line.first_segment; i < line.first_segment + line.segment_count; i++) {
+
+        const template_segment &segment = compiled.segments[i];
+
+        if (segment.variable != compiled_template::NO_VARIABLE && scratch.variable_values[segment.variable] == nullptr) {
+            std::ostringstream error_stream;
+            error_stream << "Undefined variable " << compiled.segment_text(segment) << ".";
+            checked.errors.push_back(located_error(file_path, line.line_number, error_stream.str()));
+        }
+    }
+}
+
+/*
+ * Report malformed conditions of if statement.
+ * Compiled conditions are well-formed, but values with spaces split into more words, so lines that use them
+ * are checked with values substituted, the same way they are evaluated when rendering.
+ */
+void template_checker::check_if_statement(const compiled_template &compiled, const template_line &line,
+                                          const std::string &file_path, check_scratch &scratch,
+                                          checked_template &checked) const {
+
+    bool is_compiled = line.condition_count > 0;
+
+    scratch.substituted_line.clear();
+
+    for (uint32_t i = line.first_segment; i < line.first_segment + line.segment_count; i++) {
+
+        const template_segment &segment = compiled.segments[i];
+        std::string_view text = compiled.segment_text(segment);
+
+        if (segment.variable == compiled_template::NO_VARIABLE) {
+            scratch.substituted_line.append(text.data(), text.size());
+            continue;
+        }
+
+        const env_value *value = scratch.variable_values[segment.variable];
+
+        // undefined variables are already reported, so they are kept as they are
+        if (value == nullptr) {
+            scratch.substituted_line.append(this->definer).append("{").append(text.data(), text.size()).append("}");
+            continue;
+        }
+
+        is_compiled = is_compiled && !value->has_space;
+        scratch.substituted_line.append(value->value);
+    }
+
+    if (is_compiled) return;
+
+    try {
+        parsing_utils::evaluate_if_statement_words<true>(string_utils::trim_view(scratch.substituted_line));
+    }
+    catch (std::runtime_error &error) {
+        checked.errors.push_back(located_error(file_path, line.line_number, error.what()));
+    }
+}
+
+/*
+ * Bind loop variable of for statement until its endfor, since the body is checked once.
+ * Loop variable takes the first item, or the first one with spaces, which splits if statement conditions
+ * into more words. Reports list variable that isn't a list.
+ */
+void template_checker::begin_loop(const compiled_template &compiled, const template_line &line,
+                                  const std::string &file_path, check_scratch &scratch,
+                                  checked_template &checked) const {
+
+    const env_value *list = scratch.variable_values[line.list_variable];
+    const env_value *item = &LOOP_ITEM;
+
+    if (list != nullptr && !list->is_list) {
+        std::ostringstream error_stream;
+        error_stream << "Variable " << compiled.segment_text(compiled.variables[line.list_variable])
+                     << " isn't a list. Lists are written as [A, B, C].";
+        checked.errors.push_back(located_error(file_path, line.line_number, error_stream.str()));
+    } else if (list != nullptr) {
+
+        for (const auto &list_item : list->items) {
+
+            if (item == &LOOP_ITEM || list_item.has_space) {
+                item = &list_item;
+            }
+
+            if (item->has_space) break;
+        }
+    }
+
+    scratch.open_loops.push_back({line.loop_variable, scratch.variable_values[line.loop_variable],
+                                  scratch.open_if_statements.size()});
+    scratch.variable_values[line.loop_variable] = item;
+
+    checked.loop_variable_names.emplace_back(compiled.segment_text(compiled.variables[line.loop_variable]));
+}
+
+/*
+ * Restore loop variable of innermost for statement and report if statements that didn't end inside of it.
+ */
+void template_checker::end_loop(const std::string &file_path, check_scratch &scratch,
+                                checked_template &checked) const {
+
+    const open_loop &loop = scratch.open_loops.back();
+
+    for (size_t i = loop.if_statements_before; i < scratch.open_if_statements.size(); i++) {
+        checked.errors.push_back(located_error(file_path, scratch.open_if_statements[i], EXPECTED_ENDIF));
+    }
+
+    scratch.open_if_statements.resize(loop.if_statements_before);
+    scratch.variable_values[loop.loop_variable] = loop.outer_value;
+    scratch.open_loops.pop_back();
+}
+
+/*
+ * Check every line of compiled template, collecting all errors and included templates.
+ */
+void template_checker::check_lines(const compiled_template &compiled, const std::string &file_path,
+                                   bool is_partial, check_scratch &scratch, checked_template &checked) const {
+
+    // line numbers of if statements that haven't ended yet
+    scratch.open_if_statements.clear();
+    scratch.open_loops.clear();
+
+    this->resolve_variables(compiled, is_partial, scratch);
+
+    for (const auto &line : compiled.lines) {
+
+        switch (line.kind) {
+
+            case template_line_kind::EMPTY:
+                break;
+
+            case template_line_kind::TEXT:
+                this->check_variables(compiled, line, file_path, scratch, checked);
+                break;
+
+            case template_line_kind::IF:
+                this->check_variables(compiled, line, file_path, scratch, checked);
+                this->check_if_statement(compiled, line, file_path, scratch, checked);
+                scratch.open_if_statements.push_back(line.line_number);
+                break;
+
+            case template_line_kind::ENDIF:
+
+                // if statements can't end outside of for statement they started in
+                if (scratch.open_if_statements.size() <=
+                    (scratch.open_loops.empty() ? 0 : scratch.open_loops.back().if_statements_before)) {
+                    checked.errors.push_back(located_error(file_path, line.line_number, "No endif expected here."));
+                } else {
+                    scratch.open_if_statements.pop_back();
+                }
+                break;
+
+            case template_line_kind::FOR:
+                this->check_variables(compiled, line, file_path, scratch, checked);
+                this->begin_loop(compiled, line, file_path, scratch, checked);
+                break;
+
+            case template_line_kind::ENDFOR:
+                this->end_loop(file_path, scratch, checked);
+                break;
+
+            case template_line_kind::INCLUDE:
+
+                try {
+                    const partial_template &partial = this->partials->get(
+                            file_path, compiled.segment_text(compiled.segments[line.first_segment]));
+
+                    checked.includes.emplace_back(&partial, line.line_number);
+                }
+                catch (std::runtime_error &error) {
+                    checked.errors.push_back(located_error(file_path, line.line_number, error.what()));
+                }
+                break;
+
+            case template_line_kind::ERROR:
+                this->check_variables(compiled, line, file_path, scratch, checked);
+                checked.errors.push_back(located_error(file_path, line.line_number, compiled.errors[line.error]));
+                break;
+        }
+    }
+
+    for (int line_number : scratch.open_if_statements) {
+        checked.errors.push_back(located_error(file_path, line_number, EXPECTED_ENDIF));
+    }
+}
+
+/*
+ * Report every include statement that closes a cycle of included templates.
+ */
+void template_checker::check_include_cycles(
+        const std::vector<const partial_template *> &included_partials,
+        const std::unordered_map<const partial_template *, size_t> &partial_indexes,
+        std::vector<checked_template> &checked_partials) const {
+
+    enum class visit_state : uint8_t {
+        NOT_VISITED,
+        ON_PATH,
+        VISITED
+    };
+
+    std::vector<visit_state> states(included_partials.size(), visit_state::NOT_VISITED);
+    std::vector<size_t> path;
+
+    std::function<void(size_t)> visit = [&](size_t partial) {
+
+        states[partial] = visit_state::ON_PATH;
+        path.push_back(partial);
+
+        for (const auto &include : checked_partials[partial].includes) {
+
+            size_t included = partial_indexes.at(include.first);
+
+            if (states[included] == visit_state::NOT_VISITED) {
+                visit(included);
+            } else if (states[included] == visit_state::ON_PATH) {
+
+                std::ostringstream error_stream;
+                error_stream << "Include cycle: ";
+
+                for (auto cycle_partial = std::find(path.begin(), path.end(), included);
+                     cycle_partial != path.end(); cycle_partial++) {
+                    error_stream << included_partials[*cycle_partial]->file_path << " -> ";
+                }
+
+                error_stream << included_partials[included]->file_path << ".";
+
+                checked_partials[partial].errors.push_back(
+                        located_error(included_partials[partial]->file_path, include.second, error_stream.str()));
+            }
+        }
+
+        path.pop_back();
+        states[partial] = visit_state::VISITED;
+    };
+
+    for (size_t partial = 0; partial < included_partials.size(); partial++) {
+        if (states[partial] == visit_state::NOT_VISITED) {
+            visit(partial);
+        }
+    }
+}
+
+/*
+ * Check templates at file_paths and every template they include, in parallel.
+ * Returns all errors: errors of templates in the order they were given, followed by errors of included templates,
+ * sorted by their path. partial_count is set to number of included templates that were checked.
+ * Environment dictionary has to be evaluated, since it is read from multiple threads.
+ */
+std::vector<std::string> template_checker::check(const std::vector<std::string> &file_paths,
+                                                 unsigned long &partial_count) {
+
+    this->loop_variable_names.clear();
+
+    std::vector<check_scratch> scratches(thread_utils::thread_count(file_paths.size()));
+    std::vector<checked_template> checked_templates(file_paths.size());
+
+    thread_utils::parallel_for(file_paths.size(), [&](unsigned long i, unsigned int thread) {
+
+        check_scratch &scratch = scratches[thread];
+
+        if (!file_utils::read_file(file_paths[i], scratch.source)) {
+            checked_templates[i].errors.push_back("Template file " + file_paths[i] + " doesn't exist or isn't a file.");
+            return;
+        }
+
+        this->compile(scratch.source, this->definer, scratch.compiled);
+        this->check_lines(scratch.compiled, file_paths[i], false, scratch, checked_templates[i]);
+    });
+
+    // included templates are checked once, in rounds, since they can include other templates
+    std::vector<const partial_template *> included_partials;
+    std::unordered_map<const partial_template *, size_t> partial_indexes;
+    std::vector<checked_template> checked_partials;
+
+    // loop variable names are only added between rounds, since they are read while checking
+    auto add_includes = [&](const checked_template &checked) {
+        for (const auto &include : checked.includes) {
+            if (partial_indexes.emplace(include.first, included_partials.size()).second) {
+                included_partials.push_back(include.first);
+            }
+        }
+
+        this->loop_variable_names.insert(checked.loop_variable_names.begin(), checked.loop_variable_names.end());
+    };
+
+    for (const auto &checked : checked_templates) {
+        add_includes(checked);
+    }
+
+    size_t checked_count = 0;
+
+    while (checked_count < included_partials.size()) {
+
+        size_t first_partial = checked_count;
+        size_t round_count = included_partials.size() - first_partial;
+
+        checked_partials.resize(included_partials.size());
+        scratches.resize(std::max<size_t>(scratches.size(), thread_utils::thread_count(round_count)));
+
+        thread_utils::parallel_for(round_count, [&](unsigned long i, unsigned int thread) {
+            const partial_template *partial = included_partials[first_partial + i];
+            this->check_lines(partial->compiled, partial->file_path, true, scratches[thread],
+                              checked_partials[first_partial + i]);
+        });
+
+        checked_count = included_partials.size();
+
+        for (size_t i = first_partial; i < checked_count; i++) {
+            add_includes(checked_partials[i]);
+        }
+    }
+
+    this->check_include_cycles(included_partials, partial_indexes, checked_partials);
+
+    std::vector<std::string> errors;
+
+    for (auto &checked : checked_templates) {
+        std::move(checked.errors.begin(), checked.errors.end(), std::back_inserter(errors));
+    }
+
+    std::vector<size_t> partial_order(included_partials.size());
+
+    for (size_t i = 0; i < partial_order.size(); i++) {
+        partial_order[i] = i;
+    }
+
+    std::sort(partial_order.begin(), partial_order.end(), [&](size_t a, size_t b) {
+        return included_partials[a]->file_path < included_partials[b]->file_path;
+    });
+
+    for (size_t partial : partial_order) {
+        auto &checked = checked_partials[partial];
+        std::move(checked.errors.begin(), checked.errors.end(), std::back_inserter(errors));
+    }
+
+    partial_count = included_partials.size();
+
+    return errors;
+}
@@ -0,0 +1,91 @@
+#ifndef CONFIG_GENERATOR_TEMPLATE_CHECKER_H
+#define CONFIG_GENERATOR_TEMPLATE_CHECKER_H
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "compiled_template.h"
+#include "partial_cache.h"
+#include "env_dictionary.h"
+
+/*
+ * Checks templates without rendering them: syntax errors, if statements without endif and the other way around,
+ * malformed conditions, undefined variables, for statements over variables that aren't lists
+ * and includes that don't exist or include themselves.
+ * All errors are collected, instead of stopping at the first one, and templates are checked in parallel.
+ * Included templates are checked once, no matter how many templates include them.
+ */
+class template_checker {
+
+private:
+
+    /*
+     * Errors of one template, and templates it includes, with line numbers of include statements.
+     */
+    struct checked_template {
+        std::vector<std::string> errors;
+        std::vector<std::pair<const partial_template *, int>> includes;
+        std::vector<std::string> loop_variable_names;
+    };
+
+    /*
+     * For statement that hasn't ended yet, with value its loop variable had before it.
+     */
+    struct open_loop {
+        int32_t loop_variable;
+        const env_value *outer_value;
+        size_t if_statements_before;
+    };
+
+    /*
+     * Scratch space of one checking thread, reused between templates.
+     */
+    struct check_scratch {
+        std::string source;
+        compiled_template compiled;
+        std::string substituted_line;
+        std::string variable_name;
+        std::vector<const env_value *> variable_values;
+        std::vector<int> open_if_statements;
+        std::vector<open_loop> open_loops;
+    };
+
+    std::string definer;
+    compiled_template::compile_kernel compile;
+
+    const env_dictionary *env_var_dictionary;
+    partial_cache *partials;
+
+    // loop variables of every checked template, which templates included inside of loops can use
+    std::unordered_set<std::string> loop_variable_names;
+
+    void resolve_variables(const compiled_template &compiled, bool is_partial, check_scratch &scratch) const;
+
+    void check_variables(const compiled_template &compiled, const template_line &line, const std::string &file_path,
+                         const check_scratch &scratch, checked_template &checked) const;
+
+    void check_if_statement(const compiled_template &compiled, const template_line &line,
+                            const std::string &file_path, check_scratch &scratch, checked_template &checked) const;
+
+    void begin_loop(const compiled_template &compiled, const template_line &line, const std::string &file_path,
+                    check_scratch &scratch, checked_template &checked) const;
+
+    void end_loop(const std::string &file_path, check_scratch &scratch, checked_template &checked) const;
+
+    void check_lines(const compiled_template &compiled, const std::string &file_path, bool is_partial,
+                     check_scratch &scratch, checked_template &checked) const;
+
+    void check_include_cycles(const std::vector<const partial_template *> &included_partials,
+                              const std::unordered_map<const partial_template *, size_t> &partial_indexes,
+                              std::vector<checked_template> &checked_partials) const;
+
+public:
+    template_checker(std::string definer, const env_dictionary &env_var_dictionary, partial_cache &partials);
+
+    std::vector<std::string> check(const std::vector<std::string> &file_paths, unsigned long &partial_count);
+};
+
+
+#endif //CONFIG_GENERATOR_TEMPLATE_CHECKER_H
@@ -0,0 +1,358 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include "template_index.h"
+#include "string_utils.h"
+#include "parsing_utils.h"
+
+const std::string
+        INDEX_HEADER = "# config-generator template index v2",
+        KIND_SUBSTITUTED = "var",
+        KIND_CONDITIONED = "if",
+        KIND_TEMPLATE = "template",
+        KIND_FILE = "file";
+
+namespace {
+
+    /*
+     * Modification time (in nanoseconds) and size of file. Returns false if file doesn't exist.
+     */
+    bool stat_file(const std::string &file_path, int64_t &modified_time, int64_t &size) {
+
+        struct stat file_stat{};
+
+        if (stat(file_path.c_str(), &file_stat) != 0) {
+            return false;
+        }
+
+        modified_time = static_cast<int64_t>(file_stat.st_mtim.tv_sec) * 1000000000 + file_stat.st_mtim.tv_nsec;
+        size = static_cast<int64_t>(file_stat.st_size);
+
+        return true;
+    }
+
+    /*
+     * Absolute path of file, so that index can be used from any working directory.
+     * Returns file_path as it is if file doesn't exist.
+     */
+    std::string absolute_path(const std::string &file_path) {
+
+        char *resolved_path = realpath(file_path.c_str(), nullptr);
+        std::string absolute = resolved_path != nullptr ? resolved_path : file_path;
+        free(resolved_path);
+
+        return absolute;
+    }
+}
+
+void template_index::clear() {
+    this->substituted_in.clear();
+    this->conditioned_in.clear();
+    this->indexed_templates.clear();
+}
+
+/*
+ * Record that template references variable, in substituted_in or conditioned_in.
+ */
+void template_index::add_variable(std::map<std::string, std::set<std::string>> &variable_templates,
+                                  std::string_view name, const std::string &template_name) {
+
+    std::string variable_name(name);
+
+    variable_templates[variable_name].insert(template_name);
+    this->indexed_templates[template_name].variables.insert(std::move(variable_name));
+}
+
+/*
+ * Analyse template text and record every variable it references.
+ * Variables on lines that are if statements are recorded as used in conditions.
+ * Loop variables of for statements take the items of their list, so they aren't recorded inside of their loop.
+ * file_path is file that template_source was read from, either the template or a template it includes,
+ * whose absolute path, modification time and size are kept to find out if template changed.
+ * Previous entries of the same template are not removed, so that included templates are added to it;
+ * templates that are analysed again have to be removed first.
+ * Returns paths of templates included with %INCLUDE, which are not analysed here.
+ */
+std::vector<std::string> template_index::add_template(const std::string &template_name, const std::string &file_path,
+                                                      std::string_view template_source, std::string_view definer) {
+
+    file_stamp stamp{absolute_path(file_path), 0, 0};
+
+    // file that can't be found anymore is analysed again on next load
+    if (!stat_file(file_path, stamp.modified_time, stamp.size)) {
+        stamp.modified_time = -1;
+    }
+
+    this->indexed_templates[template_name].files.push_back(std::move(stamp));
+
+    std::vector<std::string> include_paths;
+
+    // loop variables of for statements that haven't ended yet
+    std::vector<std::string_view> loop_variables;
+
+    size_t line_start = 0;
+
+    while (line_start < template_source.size()) {
+
+        size_t line_end = template_source.find('\n', line_start);
+
+        if (line_end == std::string_view::npos) {
+            line_end = template_source.size();
+        }
+
+        std::string_view line = template_source.substr(line_start, line_end - line_start);
+        line_start = line_end + 1;
+
+        std::string_view trimmed_line = string_utils::trim_view(line);
+        std::string_view include_path, loop_variable, list_variable;
+        bool is_if_statement = false;
+
+        // malformed statements are reported when template is rendered, their variables are still indexed
+        try {
+            if (parsing_utils::is_line_include_statement(trimmed_line, definer, include_path)) {
+                include_paths.emplace_back(include_path);
+                continue;
+            }
+
+            if (parsing_utils::is_line_for_statement(trimmed_line, definer, loop_variable, list_variable)) {
+
+                if (std::find(loop_variables.begin(), loop_variables.end(), list_variable) == loop_variables.end()) {
+                    this->add_variable(this->substituted_in, list_variable, template_name);
+                }
+
+                loop_variables.push_back(loop_variable);
+                continue;
+            }
+
+            if (parsing_utils::is_line_endfor_statement(trimmed_line, definer)) {
+
+                if (!loop_variables.empty()) {
+                    loop_variables.pop_back();
+                }
+
+                continue;
+            }
+
+            is_if_statement = parsing_utils::is_line_if_statement(trimmed_line, definer);
+        }
+        catch (std::runtime_error &) {}
+
+        auto &variable_templates = is_if_statement ? this->conditioned_in : this->substituted_in;
+
+        size_t position = 0, variable_start, name_end;
+
+        while (parsing_utils::find_variable(line, definer, position, variable_start, name_end)) {
+
+            size_t name_start = variable_start + definer.size() + 1;
+
+            std::string_view name = line.substr(name_start, name_end - name_start);
+
+            bool is_loop_variable = std::find(loop_variables.begin(), loop_variables.end(), name) !=
+                                    loop_variables.end();
+
+            if (!name.empty() && !is_loop_variable) {
+                this->add_variable(variable_templates, name, template_name);
+            }
+
+            position = name_end + 1;
+        }
+    }
+
+    return include_paths;
+}
+
+/*
+ * Return names of all templates whose output may change if any of given variables changes.
+ */
+std::set<std::string> template_index::affected_by(const std::vector<std::string> &variable_names) const {
+
+    std::set<std::string> affected_templates;
+
+    for (const auto &variable_name : variable_names) {
+
+        for (const auto *variable_templates : {&this->substituted_in, &this->conditioned_in}) {
+
+            auto templates = variable_templates->find(variable_name);
+
+            if (templates != variable_templates->end()) {
+                affected_templates.insert(templates->second.begin(), templates->second.end());
+            }
+        }
+    }
+
+    return affected_templates;
+}
+
+/*
+ * Remove every entry of template, so that it can be analysed again.
+ */
+void template_index::remove_template(const std::string &template_name) {
+
+    auto indexed = this->indexed_templates.find(template_name);
+
+    if (indexed == this->indexed_templates.end()) return;
+
+    for (const auto &variable_name : indexed->second.variables) {
+        for (auto *variable_templates : {&this->substituted_in, &this->conditioned_in}) {
+
+            auto templates = variable_templates->find(variable_name);
+
+            if (templates == variable_templates->end()) continue;
+
+            templates->second.erase(template_name);
+
+            if (templates->second.empty()) {
+                variable_templates->erase(templates);
+            }
+        }
+    }
+
+    this->indexed_templates.erase(indexed);
+}
+
+bool template_index::contains(const std::string &template_name) const {
+    return this->indexed_templates.count(template_name) > 0;
+}
+
+/*
+ * Return names and file paths of templates whose file, or a file they include, changed or was removed
+ * since template was analysed.
+ */
+std::vector<std::pair<std::string, std::string>> template_index::stale_templates() const {
+
+    std::vector<std::pair<std::string, std::string>> stale;
+
+    for (const auto &indexed : this->indexed_templates) {
+
+        const std::vector<file_stamp> &files = indexed.second.files;
+
+        bool is_stale = files.empty() || std::any_of(files.begin(), files.end(), [](const file_stamp &stamp) {
+            int64_t modified_time, size;
+            return !stat_file(stamp.file_path, modified_time, size) || modified_time != stamp.modified_time ||
+                   size != stamp.size;
+        });
+
+        if (is_stale) {
+            stale.emplace_back(indexed.first, files.empty() ? std::string() : files.front().file_path);
+        }
+    }
+
+    return stale;
+}
+
+/*
+ * Return names of all variables used by any template, sorted.
+ */
+std::vector<std::string> template_index::variables() const {
+
+    std::set<std::string> variable_names;
+
+    for (const auto &variable_templates : this->substituted_in) {
+        variable_names.insert(variable_templates.first);
+    }
+
+    for (const auto &variable_templates : this->conditioned_in) {
+        variable_names.insert(variable_templates.first);
+    }
+
+    return std::vector<std::string>(variable_names.begin(), variable_names.end());
+}
+
+/*
+ * Write index to file, one tab separated entry per line: kind, variable, template.
+ * Files of templates are written as kind, file path, template, modification time and size.
+ * Throws runtime_error if file can't be written.
+ */
+void template_index::save(const std::string &file_path) const {
+
+    std::ofstream index_file(file_path);
+
+    if (!index_file.good()) {
+        std::ostringstream error_stream;
+        error_stream << "Can't write template index " << file_path << ".";
+        throw std::runtime_error(error_stream.str());
+    }
+
+    index_file << INDEX_HEADER << '\n';
+
+    for (const auto &indexed : this->indexed_templates) {
+
+        index_file << KIND_TEMPLATE << '\t' << '\t' << indexed.first << '\n';
+
+        for (const auto &stamp : indexed.second.files) {
+            index_file << KIND_FILE << '\t' << stamp.file_path << '\t' << indexed.first << '\t'
+                       << stamp.modified_time << '\t' << stamp.size << '\n';
+        }
+    }
+
+    for (const auto &variable_templates : this->substituted_in) {
+        for (const auto &template_name : variable_templates.second) {
+            index_file << KIND_SUBSTITUTED << '\t' << variable_templates.first << '\t' << template_name << '\n';
+        }
+    }
+
+    for (const auto &variable_templates : this->conditioned_in) {
+        for (const auto &template_name : variable_templates.second) {
+            index_file << KIND_CONDITIONED << '\t' << variable_templates.first << '\t' << template_name << '\n';
+        }
+    }
+}
+
+/*
+ * Replace index with contents of file, written by save.
+ * Templates that changed since the index was saved are found with stale_templates.
+ * Returns false if file doesn't exist or isn't a template index.
+ */
+bool template_index::load(const std::string &file_path) {
+
+    std::ifstream index_file(file_path);
+
+    if (!index_file.good()) {
+        return false;
+    }
+
+    std::string line;
+
+    if (!std::getline(index_file, line) || line != INDEX_HEADER) {
+        return false;
+    }
+
+    this->clear();
+
+    while (std::getline(index_file, line)) {
+
+        size_t kind_end = line.find('\t');
+        size_t variable_end = kind_end == std::string::npos ? std::string::npos : line.find('\t', kind_end + 1);
+
+        // skip malformed lines
+        if (variable_end == std::string::npos) continue;
+
+        size_t template_end = line.find('\t', variable_end + 1);
+
+        std::string kind = line.substr(0, kind_end);
+        std::string variable_name = line.substr(kind_end + 1, variable_end - kind_end - 1);
+        std::string template_name = line.substr(variable_end + 1, template_end - variable_end - 1);
+
+        if (kind == KIND_TEMPLATE) {
+            this->indexed_templates[template_name];
+        } else if (kind == KIND_SUBSTITUTED) {
+            this->add_variable(this->substituted_in, variable_name, template_name);
+        } else if (kind == KIND_CONDITIONED) {
+            this->add_variable(this->conditioned_in, variable_name, template_name);
+        } else if (kind == KIND_FILE && template_end != std::string::npos) {
+
+            // variable column holds file path
+            file_stamp stamp{variable_name, 0, 0};
+            std::istringstream stamp_stream(line.substr(template_end + 1));
+
+            if (stamp_stream >> stamp.modified_time >> stamp.size) {
+                this->indexed_templates[template_name].files.push_back(std::move(stamp));
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,75 @@
+#ifndef CONFIG_GENERATOR_TEMPLATE_INDEX_H
+#define CONFIG_GENERATOR_TEMPLATE_INDEX_H
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Inverted index of template dependencies: for every variable, the templates that reference it,
+ * either through substitution (%{VAR}) or inside of if statement conditions.
+ * Index is built by static analysis of template text, so nothing is rendered to build it,
+ * and can be saved to and loaded from a file.
+ * Every template keeps modification time and size of its file and the files it includes, so that templates
+ * that changed since they were analysed can be found and analysed again.
+ */
+class template_index {
+
+private:
+
+    /*
+     * File that template was analysed from, as it was when it was analysed.
+     */
+    struct file_stamp {
+        std::string file_path;
+        int64_t modified_time;
+        int64_t size;
+    };
+
+    /*
+     * Analysed template: its file and the files it includes, template file first,
+     * and variables it is recorded under, so that its entries can be removed.
+     */
+    struct indexed_template {
+        std::vector<file_stamp> files;
+        std::set<std::string> variables;
+    };
+
+    // variable name -> names of templates that substitute it
+    std::map<std::string, std::set<std::string>> substituted_in;
+
+    // variable name -> names of templates that use it in if statement conditions
+    std::map<std::string, std::set<std::string>> conditioned_in;
+
+    // every analysed template, including those without variables
+    std::map<std::string, indexed_template> indexed_templates;
+
+    void add_variable(std::map<std::string, std::set<std::string>> &variable_templates, std::string_view name,
+                      const std::string &template_name);
+
+public:
+    void clear();
+
+    std::vector<std::string> add_template(const std::string &template_name, const std::string &file_path,
+                                          std::string_view template_source, std::string_view definer);
+
+    void remove_template(const std::string &template_name);
+
+    bool contains(const std::string &template_name) const;
+
+    std::vector<std::pair<std::string, std::string>> stale_templates() const;
+
+    std::set<std::string> affected_by(const std::vector<std::string> &variable_names) const;
+
+    std::vector<std::string> variables() const;
+
+    void save(const std::string &file_path) const;
+
+    bool load(const std::string &file_path);
+};
+
+
+#endif //CONFIG_GENERATOR_TEMPLATE_INDEX_H
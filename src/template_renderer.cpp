@@ -0,0 +1,473 @@
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include "template_renderer.h"
+#include "string_utils.h"
+#include "parsing_utils.h"
+
+namespace {
+
+    /*
+     * Error that already has file and line it happened at, such as error in included template.
+     */
+    struct located_error : public std::runtime_error {
+        using std::runtime_error::runtime_error;
+    };
+}
+
+template_renderer::template_renderer(std::string definer, bool is_case_sensitive,
+                                     env_dictionary &env_var_dictionary,
+                                     partial_cache &partials)
+        : definer(std::move(definer)), env_var_dictionary(&env_var_dictionary), partials(&partials) {
+
+    this->compile = compiled_template::select_compile_kernel(this->definer);
+    this->render_compiled = is_case_sensitive ? &template_renderer::render_template<true>
+                                              : &template_renderer::render_template<false>;
+}
+
+/*
+ * Look up every variable of template in env_var_dictionary once.
+ * Undefined variables are kept as nullptr and reported only when their line is rendered.
+ */
+void template_renderer::resolve_variables(const compiled_template &compiled, variable_values_list &values) {
+
+    values.clear();
+
+    for (const auto &variable : compiled.variables) {
+
+        std::string_view name = compiled.segment_text(variable);
+        this->variable_name.assign(name.data(), name.size());
+
+        values.push_back(this->env_var_dictionary->find(this->variable_name));
+    }
+}
+
+/*
+ * Append line to output, with variables substituted.
+ * Throws runtime_error if line uses undefined variable.
+ */
+template<typename OUTPUT>
+void template_renderer::append_line(const compiled_template &compiled, const variable_values_list &values,
+                                    const template_line &line, OUTPUT &output) {
+
+    for (uint32_t i = line.first_segment; i < line.first_segment + line.segment_count; i++) {
+
+        const template_segment &segment = compiled.segments[i];
+
+        if (segment.variable == compiled_template::NO_VARIABLE) {
+            output.append(compiled.segment_text(segment));
+            continue;
+        }
+
+        const env_value *value = values[segment.variable];
+
+        if (value == nullptr) {
+            std::ostringstream error_stream;
+            error_stream << "Undefined variable " << compiled.segment_text(segment) << ".";
+            throw std::runtime_error(error_stream.str());
+        }
+
+        output.append(value->value);
+    }
+}
+
+/*
+ * Throws runtime_error if line uses undefined variable, without writing it anywhere.
+ */
+void template_renderer::check_line_variables(const compiled_template &compiled, const variable_values_list &values,
+                                             const template_line &line) {
+
+    for (uint32_t i = line.first_segment; i < line.first_segment + line.segment_count; i++) {
+
+        const template_segment &segment = compiled.segments[i];
+
+        if (segment.variable != compiled_template::NO_VARIABLE && values[segment.variable] == nullptr) {
+            std::ostringstream error_stream;
+            error_stream << "Undefined variable " << compiled.segment_text(segment) << ".";
+            throw std::runtime_error(error_stream.str());
+        }
+    }
+}
+
+/*
+ * Value of operand to compare: case folded, unless comparisons are case sensitive.
+ */
+template<bool CASE_SENSITIVE>
+std::string_view template_renderer::operand_value(const compiled_template &compiled,
+                                                  const variable_values_list &values,
+                                                  const template_operand &operand) const {
+
+    if (operand.variable == compiled_template::NO_VARIABLE) {
+        return CASE_SENSITIVE ? compiled.operand_text(operand) : compiled.operand_folded_text(operand);
+    }
+
+    const env_value *value = values[operand.variable];
+
+    return CASE_SENSITIVE ? value->value : value->folded;
+}
+
+/*
+ * Evaluate compiled conditions of if statement line into evaluation.
+ * Returns false if line has to be evaluated from substituted text instead: it has no compiled conditions,
+ * uses undefined variable (which is reported from substituted text) or a value that would split into more words.
+ */
+template<bool CASE_SENSITIVE>
+bool template_renderer::evaluate_conditions(const compiled_template &compiled, const variable_values_list &values,
+                                            const template_line &line, bool &evaluation) const {
+
+    if (line.condition_count == 0) return false;
+
+    for (uint32_t i = line.first_segment; i < line.first_segment + line.segment_count; i++) {
+
+        const template_segment &segment = compiled.segments[i];
+
+        if (segment.variable == compiled_template::NO_VARIABLE) continue;
+
+        const env_value *value = values[segment.variable];
+
+        if (value == nullptr || value->has_space) return false;
+    }
+
+    for (uint32_t i = line.first_condition; i < line.first_condition + line.condition_count; i++) {
+
+        const template_condition &condition = compiled.conditions[i];
+
+        // values are already case folded, so both modes compare lengths and bytes
+        bool condition_evaluation = (this->operand_value<CASE_SENSITIVE>(compiled, values, condition.left) ==
+                                     this->operand_value<CASE_SENSITIVE>(compiled, values, condition.right)) !=
+                                    condition.is_not;
+
+        switch (condition.logical_operator) {
+            case template_logical_operator::NONE:
+                evaluation = condition_evaluation;
+                break;
+            case template_logical_operator::AND:
+                evaluation = evaluation && condition_evaluation;
+                break;
+            case template_logical_operator::OR:
+                evaluation = evaluation || condition_evaluation;
+                break;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Bind variables of partial that have the same name as loop variables of for statements it is included from,
+ * to their current items, so that loop variables can be used in included templates.
+ */
+void template_renderer::bind_loop_variables(const compiled_template &compiled, variable_values_list &values) {
+
+    for (const auto &loop : this->loop_stack) {
+        for (size_t i = 0; i < compiled.variables.size(); i++) {
+
+            if (compiled.segment_text(compiled.variables[i]) != loop.loop_variable_name) continue;
+
+            this->bound_partial_values.emplace_back(&values[i], values[i]);
+            values[i] = &loop.list->items[loop.item];
+        }
+    }
+}
+
+/*
+ * End for statements above loops_before, restoring values of their loop variables, such as when rendering fails.
+ */
+void template_renderer::end_loops(size_t loops_before) {
+
+    while (this->loop_stack.size() > loops_before) {
+        loop_frame &loop = this->loop_stack.back();
+        (*loop.values)[loop.loop_variable] = loop.outer_value;
+        this->loop_stack.pop_back();
+    }
+}
+
+/*
+ * Begin for statement of line, binding its loop variable to the first item of list.
+ * Returns false if loop body is skipped: list has no items or loop isn't written.
+ * Throws runtime_error if list variable is undefined or isn't a list.
+ */
+bool template_renderer::begin_loop(const compiled_template &compiled, variable_values_list &values,
+                                   const template_line &line) {
+
+    // list is checked even if loop isn't written, the same as variables of lines that aren't written
+    this->check_line_variables(compiled, values, line);
+
+    const env_value *list = values[line.list_variable];
+
+    if (!list->is_list) {
+        std::ostringstream error_stream;
+        error_stream << "Variable " << compiled.segment_text(compiled.variables[line.list_variable])
+                     << " isn't a list. Lists are written as [A, B, C].";
+        throw std::runtime_error(error_stream.str());
+    }
+
+    bool is_written = this->if_statement_evaluations_stack.empty() || this->if_statement_evaluations_stack.back();
+
+    if (!is_written || list->items.empty()) return false;
+
+    this->loop_stack.push_back({compiled.segment_text(compiled.variables[line.loop_variable]), &values,
+                                line.loop_variable, list, 0, values[line.loop_variable],
+                                this->if_statement_evaluations_stack.size()});
+
+    values[line.loop_variable] = &list->items[0];
+
+    return true;
+}
+
+/*
+ * Move innermost for statement to its next item. Returns false if there are no more items, and loop has ended.
+ * Throws runtime_error if if statements inside of loop body didn't end in it.
+ */
+bool template_renderer::next_loop_item() {
+
+    loop_frame &loop = this->loop_stack.back();
+
+    if (this->if_statement_evaluations_stack.size() > loop.if_statements_before) {
+        throw std::runtime_error("Expected endif (check if every if statement has a corresponding endif)");
+    }
+
+    if (++loop.item < loop.list->items.size()) {
+        (*loop.values)[loop.loop_variable] = &loop.list->items[loop.item];
+        return true;
+    }
+
+    (*loop.values)[loop.loop_variable] = loop.outer_value;
+    this->loop_stack.pop_back();
+
+    return false;
+}
+
+/*
+ * Render template included by line of compiled into output, after output that is already there.
+ * Partial has its own if statements, which have to end inside of it, but it is only rendered
+ * if the block it is included from is.
+ * Throws runtime_error if partial doesn't exist or includes itself, directly or through other partials.
+ */
+template<bool CASE_SENSITIVE>
+void template_renderer::render_partial(const compiled_template &compiled, const template_line &line,
+                                       const std::string &file_path, output_buffer &output) {
+
+    const partial_template &partial = this->partials->get(file_path,
+                                                          compiled.segment_text(compiled.segments[line.first_segment]));
+
+    auto cycle_start = std::find(this->include_stack.begin(), this->include_stack.end(), &partial);
+
+    if (cycle_start != this->include_stack.end()) {
+        std::ostringstream error_stream;
+        error_stream << "Include cycle: ";
+
+        for (auto included = cycle_start; included != this->include_stack.end(); included++) {
+            error_stream << (*included)->file_path << " -> ";
+        }
+
+        error_stream << partial.file_path << ".";
+        throw std::runtime_error(error_stream.str());
+    }
+
+    auto values = this->partial_variable_values.find(&partial);
+
+    if (values == this->partial_variable_values.end()) {
+        values = this->partial_variable_values.emplace(&partial, variable_values_list()).first;
+        this->resolve_variables(partial.compiled, values->second);
+    }
+
+    size_t if_statements_before = this->if_statement_evaluations_stack.size();
+    size_t bound_values_before = this->bound_partial_values.size();
+
+    this->bind_loop_variables(partial.compiled, values->second);
+
+    auto unbind_loop_variables = [&]() {
+        while (this->bound_partial_values.size() > bound_values_before) {
+            *this->bound_partial_values.back().first = this->bound_partial_values.back().second;
+            this->bound_partial_values.pop_back();
+        }
+    };
+
+    this->include_stack.push_back(&partial);
+
+    try {
+        this->render_lines<CASE_SENSITIVE>(partial.compiled, values->second, partial.file_path, output);
+    }
+    catch (std::runtime_error &) {
+        unbind_loop_variables();
+        throw;
+    }
+
+    unbind_loop_variables();
+    this->include_stack.pop_back();
+
+    if (this->if_statement_evaluations_stack.size() > if_statements_before) {
+        std::ostringstream error_stream;
+        error_stream << "File: " << partial.file_path
+                     << ": Expected endif (check if every if statement has a corresponding endif)";
+        throw located_error(error_stream.str());
+    }
+}
+
+/*
+ * Render lines of compiled template into output, after output that is already there.
+ * Lines can only end if statements that they started themselves, and loop bodies only the ones started in them.
+ * Loop bodies are rendered once per item, with loop variable bound to the item, straight into output.
+ */
+template<bool CASE_SENSITIVE>
+void template_renderer::render_lines(const compiled_template &compiled, variable_values_list &values,
+                                     const std::string &file_path, output_buffer &output) {
+
+    size_t if_statements_before = this->if_statement_evaluations_stack.size();
+    size_t loops_before = this->loop_stack.size();
+
+    for (uint32_t line_index = 0; line_index < compiled.lines.size(); line_index++) {
+
+        const template_line &line = compiled.lines[line_index];
+
+        try {
+
+            switch (line.kind) {
+
+                case template_line_kind::EMPTY:
+                    output.append('\n');
+                    break;
+
+                case template_line_kind::TEXT:
+
+                    // is normal line, outside of if statement or inside of one that is evaluated as true?
+                    // undefined variables are errors even in lines that are not written
+                    if (this->if_statement_evaluations_stack.empty() || this->if_statement_evaluations_stack.back()) {
+                        this->append_line(compiled, values, line, output);
+                        output.append('\n');
+                    } else {
+                        this->check_line_variables(compiled, values, line);
+                    }
+                    break;
+
+                case template_line_kind::IF: {
+
+                    bool if_statement_evaluated = false;
+
+                    if (this->evaluate_conditions<CASE_SENSITIVE>(compiled, values, line, if_statement_evaluated)) {
+                        this->if_statement_evaluations_stack.push_back(if_statement_evaluated);
+                        break;
+                    }
+
+                    // substitute variables in if statement, evaluate it and put it on stack
+                    this->substituted_line.clear();
+                    this->append_line(compiled, values, line, this->substituted_line);
+
+                    this->if_statement_evaluations_stack.push_back(
+                            parsing_utils::evaluate_if_statement_words<CASE_SENSITIVE>(
+                                    string_utils::trim_view(this->substituted_line)));
+                    break;
+                }
+
+                case template_line_kind::ENDIF:
+
+                    // if no other if statements have been introduced prior (in this loop body), this is an error
+                    if (this->if_statement_evaluations_stack.size() <=
+                        (this->loop_stack.size() > loops_before ? this->loop_stack.back().if_statements_before
+                                                                : if_statements_before)) {
+                        throw std::runtime_error("No endif expected here.");
+                    }
+
+                    // take away the current if value, because the block has ended here
+                    this->if_statement_evaluations_stack.pop_back();
+                    break;
+
+                case template_line_kind::INCLUDE:
+
+                    // included templates in blocks that are not written are not read at all
+                    if (this->if_statement_evaluations_stack.empty() || this->if_statement_evaluations_stack.back()) {
+                        this->render_partial<CASE_SENSITIVE>(compiled, line, file_path, output);
+                    }
+                    break;
+
+                case template_line_kind::FOR:
+
+                    // skip to endfor, if there is nothing to render
+                    if (!this->begin_loop(compiled, values, line)) {
+                        line_index = line.matching_line;
+                    }
+                    break;
+
+                case template_line_kind::ENDFOR:
+
+                    // go back to the first line of loop body for the next item
+                    if (this->next_loop_item()) {
+                        line_index = line.matching_line;
+                    }
+                    break;
+
+                case template_line_kind::ERROR:
+                    this->check_line_variables(compiled, values, line);
+                    throw std::runtime_error(compiled.errors[line.error]);
+            }
+        }
+        catch (located_error &error) {
+            this->end_loops(loops_before);
+
+            std::ostringstream error_stream;
+            error_stream << error.what() << std::endl << "    included from " << file_path << ", line: "
+                         << line.line_number;
+            throw located_error(error_stream.str());
+        }
+        catch (std::runtime_error &error) {
+            this->end_loops(loops_before);
+
+            std::ostringstream error_stream;
+            error_stream << "File: " << file_path << ", line: " << line.line_number
+                         << ": " << error.what();
+            throw located_error(error_stream.str());
+        }
+    }
+}
+
+/*
+ * Render kernel, specialized for case sensitivity of comparisons in if statements.
+ */
+template<bool CASE_SENSITIVE>
+void template_renderer::render_template(const compiled_template &compiled, const std::string &file_path,
+                                        output_buffer &output) {
+
+    output.clear();
+
+    /*
+     * To support nested if statements, stack is introduced.
+     * When we enter if statement, the evaluation is pushed on stack.
+     * If we enter another if statement, the evaluation is again pushed on stack.
+     * When we reach endif, value is popped and next evaluation is taken for previous if statement (if it exists)
+     */
+    this->if_statement_evaluations_stack.clear();
+    this->include_stack.clear();
+    this->loop_stack.clear();
+    this->bound_partial_values.clear();
+
+    this->resolve_variables(compiled, this->variable_values);
+
+    this->render_lines<CASE_SENSITIVE>(compiled, this->variable_values, file_path, output);
+
+    if (!this->if_statement_evaluations_stack.empty()) {
+        throw std::runtime_error("Expected endif (check if every if statement has a corresponding endif)");
+    }
+}
+
+/*
+ * Compile template text and render it into output, which is cleared first.
+ * file_path is only used for error messages.
+ * Throws runtime_error with file and line on syntax errors and undefined variables.
+ */
+void template_renderer::render(std::string_view template_source, const std::string &file_path,
+                               output_buffer &output) {
+
+    this->compile(template_source, this->definer, this->compiled);
+
+    (this->*render_compiled)(this->compiled, file_path, output);
+}
+
+/*
+ * Render already compiled template into output, which is cleared first.
+ */
+void template_renderer::render(const compiled_template &compiled, const std::string &file_path,
+                               output_buffer &output) {
+
+    (this->*render_compiled)(compiled, file_path, output);
+}
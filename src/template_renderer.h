@@ -0,0 +1,114 @@
+#ifndef CONFIG_GENERATOR_TEMPLATE_RENDERER_H
+#define CONFIG_GENERATOR_TEMPLATE_RENDERER_H
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "output_buffer.h"
+#include "compiled_template.h"
+#include "partial_cache.h"
+#include "env_dictionary.h"
+
+/*
+ * Renders template text into an output_buffer.
+ * Renderer keeps its scratch space between renders, so reusing one renderer (and one output_buffer)
+ * for many templates doesn't allocate once buffers have grown to the largest template.
+ * Compile and render kernels are picked once, for the definer and case sensitivity, when renderer is created.
+ * Included templates are taken from partial_cache, which may be shared by many renderers.
+ */
+class template_renderer {
+
+private:
+    typedef void (template_renderer::*render_kernel)(const compiled_template &compiled, const std::string &file_path,
+                                                     output_buffer &output);
+
+    typedef std::vector<const env_value *> variable_values_list;
+
+    /*
+     * For statement that is being rendered: its list, item that its loop variable is bound to,
+     * and what to restore when loop ends.
+     */
+    struct loop_frame {
+        std::string_view loop_variable_name;
+        variable_values_list *values;
+        int32_t loop_variable;
+        const env_value *list;
+        size_t item;
+        const env_value *outer_value;
+        size_t if_statements_before;
+    };
+
+    std::string definer;
+    env_dictionary *env_var_dictionary;
+    partial_cache *partials;
+
+    compiled_template::compile_kernel compile;
+    render_kernel render_compiled;
+
+    // scratch space, reused between lines and renders
+    compiled_template compiled;
+    std::string substituted_line;
+    std::string variable_name;
+    variable_values_list variable_values;
+    std::vector<bool> if_statement_evaluations_stack;
+
+    // variables of partials, resolved when partial is first included, since environment doesn't change
+    std::unordered_map<const partial_template *, variable_values_list> partial_variable_values;
+
+    // partials that are currently being rendered, to detect include cycles
+    std::vector<const partial_template *> include_stack;
+
+    // for statements that are being rendered, of the template and partials that include it
+    std::vector<loop_frame> loop_stack;
+
+    // values of partial variables that are replaced by loop variables while partial is rendered
+    std::vector<std::pair<const env_value **, const env_value *>> bound_partial_values;
+
+    void resolve_variables(const compiled_template &compiled, variable_values_list &values);
+
+    template<typename OUTPUT>
+    void append_line(const compiled_template &compiled, const variable_values_list &values, const template_line &line,
+                     OUTPUT &output);
+
+    void check_line_variables(const compiled_template &compiled, const variable_values_list &values,
+                              const template_line &line);
+
+    template<bool CASE_SENSITIVE>
+    std::string_view operand_value(const compiled_template &compiled, const variable_values_list &values,
+                                   const template_operand &operand) const;
+
+    template<bool CASE_SENSITIVE>
+    bool evaluate_conditions(const compiled_template &compiled, const variable_values_list &values,
+                             const template_line &line, bool &evaluation) const;
+
+    void bind_loop_variables(const compiled_template &compiled, variable_values_list &values);
+
+    void end_loops(size_t loops_before);
+
+    bool begin_loop(const compiled_template &compiled, variable_values_list &values, const template_line &line);
+
+    bool next_loop_item();
+
+    template<bool CASE_SENSITIVE>
+    void render_partial(const compiled_template &compiled, const template_line &line, const std::string &file_path,
+                        output_buffer &output);
+
+    template<bool CASE_SENSITIVE>
+    void render_lines(const compiled_template &compiled, variable_values_list &values,
+                      const std::string &file_path, output_buffer &output);
+
+    template<bool CASE_SENSITIVE>
+    void render_template(const compiled_template &compiled, const std::string &file_path, output_buffer &output);
+
+public:
+    template_renderer(std::string definer, bool is_case_sensitive,
+                      env_dictionary &env_var_dictionary, partial_cache &partials);
+
+    void render(std::string_view template_source, const std::string &file_path, output_buffer &output);
+
+    void render(const compiled_template &compiled, const std::string &file_path, output_buffer &output);
+};
+
+
+#endif //CONFIG_GENERATOR_TEMPLATE_RENDERER_H
@@ -0,0 +1,58 @@
+#ifndef CONFIG_GENERATOR_THREAD_UTILS_H
+#define CONFIG_GENERATOR_THREAD_UTILS_H
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/*
+ * Utilities for spreading independent work between threads
+ */
+namespace thread_utils {
+
+    /*
+     * Number of threads to use for count independent items: one per core, but not more than items.
+     */
+    inline unsigned int thread_count(unsigned long count) {
+        return static_cast<unsigned int>(std::min<unsigned long>(std::max(1u, std::thread::hardware_concurrency()),
+                                                                 std::max(1ul, count)));
+    }
+
+    /*
+     * Call function(i, thread) for every i from 0 to count - 1, where thread is index of thread
+     * from 0 to thread_count(count) - 1, so that each thread can have its own scratch space.
+     * Each thread takes the next item that isn't taken yet, so uneven items are spread between threads.
+     */
+    template<typename FUNCTION>
+    void parallel_for(unsigned long count, FUNCTION function) {
+
+        unsigned int threads = thread_count(count);
+
+        if (threads <= 1) {
+
+            for (unsigned long i = 0; i < count; i++) {
+                function(i, 0u);
+            }
+
+            return;
+        }
+
+        std::atomic<unsigned long> next_item(0);
+        std::vector<std::thread> workers;
+
+        for (unsigned int t = 0; t < threads; t++) {
+            workers.emplace_back([&, t]() {
+                for (unsigned long i = next_item++; i < count; i = next_item++) {
+                    function(i, t);
+                }
+            });
+        }
+
+        for (auto &worker : workers) {
+            worker.join();
+        }
+    }
+}
+
+#endif //CONFIG_GENERATOR_THREAD_UTILS_H
@@ -0,0 +1,1217 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <stack>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../src/template_renderer.h"
+#include "../src/output_buffer.h"
+#include "../src/partial_cache.h"
+#include "../src/env_dictionary.h"
+
+/*
+ * Line by line renderer of the first release: config_generator::generate_file and the parts of string_utils and
+ * parsing_utils that it uses, copied as they were, so that it stays the reference no matter how the renderer changes.
+ * It substitutes every line first and then decides what the substituted line is.
+ * Changes are marked with "deviation:" and are the bugs that were fixed on purpose since.
+ * It knows nothing of %INCLUDE, %FOR and derived values, so templates are expanded for it first.
+ */
+namespace baseline {
+
+    namespace string_utils {
+
+        /*
+         * Trim string from left side
+         */
+        std::string left_trim(const std::string &str, const std::string &chars = "\t\n\v\f\r ") {
+
+            if (str.empty()) return str;
+
+            unsigned long i;
+            for (i = 0; i < str.length(); i++) {
+
+                // keep checking until one character is not a trimming character
+                if (chars.find(str[i]) == std::string::npos) break;
+            }
+
+            if (i > 0) {
+                return str.substr(i);
+            }
+
+            return str;
+        }
+
+        /*
+         * Trim string from right side
+         */
+        std::string right_trim(const std::string &str, const std::string &chars = "\t\n\v\f\r ") {
+
+            if (str.empty()) return str;
+
+            unsigned long i;
+            // deviation: unsigned i >= 0 never ended the loop, so strings of trimming characters were read past start
+            for (i = str.length() - 1; i < str.length(); i--) {
+
+                // keep checking until one character is not a trimming character
+                if (chars.find(str[i]) == std::string::npos) break;
+            }
+
+            // deviation: string of trimming characters is trimmed to empty string
+            if (i >= str.length()) {
+                return "";
+            }
+
+            if (i < str.length() - 1) {
+                return str.substr(0, i + 1);
+            }
+
+            return str;
+        }
+
+        /*
+         * Trim string from both sides
+         */
+        std::string trim(const std::string &str, const std::string &chars = "\t\n\v\f\r ") {
+            std::string right_trimmed = right_trim(str, chars);
+            return left_trim(right_trimmed, chars);
+        }
+
+        /*
+         * Replace str from search with replace (only first occurence)
+         */
+        std::string replace(std::string &str, const std::string &search, const std::string &replace) {
+
+            size_t start_pos = str.find(search);
+            if (start_pos == std::string::npos)
+                return str;
+
+            std::string replaced_string = str;
+            replaced_string.replace(start_pos, search.length(), replace);
+            return replaced_string;
+        }
+
+        /*
+         * Compare two strings without looking at case of characters.
+         */
+        bool compare_case_insensitive(const std::string &str1, const std::string &str2) {
+            // deviation: lengths are compared, so that a value doesn't equal every value it is a prefix of
+            return str1.size() == str2.size() &&
+                   std::equal(str1.begin(), str1.end(), str2.begin(),
+                              [](const char &a, const char &b) {
+                                  return (std::tolower(a) == std::tolower(b));
+                              });
+        }
+    }
+
+    namespace parsing_utils {
+
+        const std::string LOGICAL_AND = "AND", LOGICAL_OR = "OR";
+        const std::string CONDITIONAL_IS = "IS", CONDITIONAL_IS_NOT = "IS_NOT";
+        const std::string IF_STATEMENT = "IF", ENDIF_STATEMENT = "ENDIF";
+
+        // deviation: characters that are escaped in definer
+        const std::regex REGEX_SPECIAL_CHARACTERS(R"([\^$\\.*+?()[\]{}|])");
+
+        /*
+         * Checks if a line is an if statement.
+         * Line is an if statement if it begins with if identifier, such as %IF.
+         * Function expects string to be trimmed.
+         * Throws runtime_error if line contains if but it doesn't start with it.
+         */
+        bool is_line_if_statement(const std::string &line, const std::string &definer) {
+
+            std::string if_statement_identifier = definer + IF_STATEMENT;
+
+            bool line_begins_with_if = line.rfind(if_statement_identifier + " ") == 0;
+
+            if (line_begins_with_if) {
+                return true;
+            } else if (line.find(if_statement_identifier) != std::string::npos) {
+                std::ostringstream error_stream;
+                error_stream << "If line '" << line << "' doesn't have " << if_statement_identifier
+                             << " at the beginning.";
+                throw std::runtime_error(error_stream.str());
+            }
+
+            return false;
+        }
+
+        /*
+         * Checks if a line is an endif statement.
+         * Line is an endif statement if it only contains and endif identifier, such as %ENDIF.
+         * Function expects string to be trimmed.
+         * Throws runtime_error if line contains endif but it isn't the only thing in the line.
+         */
+        bool is_line_endif_statement(const std::string &line, const std::string &definer) {
+
+            std::string endif_statement_identifier = definer + ENDIF_STATEMENT;
+
+            bool line_is_exactly_endif = line == endif_statement_identifier;
+
+            if (line_is_exactly_endif) {
+                return true;
+            } else if (line.find(endif_statement_identifier) != std::string::npos) {
+                std::ostringstream error_stream;
+                error_stream << "Endif line '" << line << "' contains additional text. Endif lines should contain only "
+                             << endif_statement_identifier << ".";
+                throw std::runtime_error(error_stream.str());
+            }
+
+            return false;
+        }
+
+        /*
+         * Returns val right_side logical_operator left_side
+         * Throws runtime_error if invalid logical operator
+         */
+        bool evaluate_logical_operator(bool left_side, const std::string &logical_operator, bool right_side) {
+
+            if (logical_operator == LOGICAL_AND) {
+                return left_side && right_side;
+            } else if (logical_operator == LOGICAL_OR) {
+                return left_side || right_side;
+            }
+
+            std::ostringstream error_stream;
+            error_stream << "Unknown logical operator '" << logical_operator << "'.";
+            throw std::runtime_error(error_stream.str());
+        }
+
+        /*
+         * Returns val right_side logical_operator left_side
+         * Throws runtime_error if invalid conditional operator
+         */
+        bool evaluate_conditional_operator(const std::string &left_side, const std::string &conditional_operator,
+                                           const std::string &right_side, bool case_sensitive = false) {
+
+            if (conditional_operator == CONDITIONAL_IS) {
+
+                // deviation: case_sensitive compared case insensitively, and the other way around
+                if (!case_sensitive) {
+                    return string_utils::compare_case_insensitive(left_side, right_side);
+                } else {
+                    return left_side == right_side;
+                }
+
+            } else if (conditional_operator == CONDITIONAL_IS_NOT) {
+
+                // deviation: case_sensitive compared case insensitively, and the other way around
+                if (!case_sensitive) {
+                    return !string_utils::compare_case_insensitive(left_side, right_side);
+                } else {
+                    return left_side != right_side;
+                }
+            }
+
+            std::ostringstream error_stream;
+            error_stream << "Unknown conditional operator '" << conditional_operator << "'.";
+            throw std::runtime_error(error_stream.str());
+        }
+
+        /*
+         * Evaluate line that is considered an if statement. If line isn't an if statement, return true.
+         * Function assumes variables are already replaced and that string is trimmed!
+         * Eg. %IF DEVELOPMENT IS DEVELOPMENT will work, but %IF %{MODE} IS DEVELOPMENT wont!
+         * Throws runtime_error for syntax errors
+         */
+        bool evaluate_if_statement_line(const std::string &line, const std::string &definer, bool case_sensitive) {
+
+            // evaluate non if statements as "true"
+            if (!is_line_if_statement(line, definer)) {
+                return true;
+            }
+
+            // split whole line by spaces
+            std::vector<std::string> line_split_by_spaces;
+
+            std::stringstream ss(line);
+            std::string token;
+            while (std::getline(ss, token, ' ')) {
+
+                line_split_by_spaces.push_back(token);
+            }
+
+            // should not happen
+            if (line_split_by_spaces.empty()) {
+                return true;
+            }
+
+            // subcondition -> one sub condition in whole if statement (separated by logical operators)
+            // eg. IF A IS B -> 4 words
+            // or  AND B IS C -> 4 words
+            const int WORDS_IN_IF_SUBCONDITION = 4;
+
+            if (line_split_by_spaces.size() % WORDS_IN_IF_SUBCONDITION != 0) {
+                std::ostringstream error_stream;
+                error_stream << "If line '" << line
+                             << "' has invalid amount of words (expected 4, 8, 12, ..., but got "
+                             << line_split_by_spaces.size() << ".";
+                throw std::runtime_error(error_stream.str());
+            }
+
+            bool final_if_statement_value = false;
+
+            // iterate vector as 2D array, so i will jump by one, but it actually jumps by WORDS_IN_IF_LINE.
+            for (unsigned long i = 0; i < line_split_by_spaces.size() / WORDS_IN_IF_SUBCONDITION; i++) {
+
+                std::string current_logical_operator;
+
+                // if we are in second if substatement, because first one contains IF word
+                if (i > 0) {
+
+                    current_logical_operator = line_split_by_spaces[i * WORDS_IN_IF_SUBCONDITION];
+                }
+
+                // get other values in this if statement by pseudo 2D array indexing
+                std::string left_val = line_split_by_spaces[i * WORDS_IN_IF_SUBCONDITION + 1];
+                std::string conditional_operator = line_split_by_spaces[i * WORDS_IN_IF_SUBCONDITION + 2];
+                std::string right_val = line_split_by_spaces[i * WORDS_IN_IF_SUBCONDITION + 3];
+
+                // evaluate this statement
+                bool current_statement_value = evaluate_conditional_operator(left_val, conditional_operator,
+                                                                             right_val, case_sensitive);
+
+                if (i == 0) {
+
+                    // first line: just assign the result to final value
+                    final_if_statement_value = current_statement_value;
+
+                } else {
+
+                    // subsequent lines: add boolean to accumulated final value
+                    final_if_statement_value = evaluate_logical_operator(final_if_statement_value,
+                                                                         current_logical_operator,
+                                                                         current_statement_value);
+                }
+            }
+
+            return final_if_statement_value;
+        }
+
+        /*
+         * Substitutes any variables in the line, using the dictionary provided (env_var_dictionary).
+         * Uses definer with curly braces to replace variables.
+         * For example %{HELLO} will be replaces with whatever HELLO points to in env_var_dictionary.
+         * Throws runtime_error if HELLO doesn't exist in env_var_dictionary.
+         * If variable is empty (%{}), then throw error as well.
+         */
+        std::string substitute_vars(std::string line, const std::string &definer,
+                                    std::unordered_map<std::string, std::string> &env_var_dictionary) {
+
+            std::ostringstream error_stream;
+
+            // deviation: definer is escaped, so that definers such as $ match themselves instead of being regex
+            std::regex var_pattern(std::regex_replace(definer, REGEX_SPECIAL_CHARACTERS, R"(\$&)") + "\\{(.*?)\\}");
+
+            std::smatch match_result;
+            std::string substituted_line = line;
+
+            while (std::regex_search(line, match_result, var_pattern)) {
+
+                // there should be exactly 2 results, but check anyway
+                if (match_result.size() >= 2) {
+
+                    std::string variable_name = match_result[1].str();
+
+                    if (variable_name.empty()) {
+                        error_stream << "Empty variable.";
+                        throw std::runtime_error(error_stream.str());
+                    } else if (env_var_dictionary.find(variable_name) == env_var_dictionary.end()) {
+                        error_stream << "Undefined variable " << variable_name << ".";
+                        throw std::runtime_error(error_stream.str());
+                    }
+
+                    std::string unsubstituted_variable = match_result[0].str();
+
+                    // in line that will be returned, replace the original variable (%{...}) with value,
+                    // found in dictionary
+                    substituted_line = string_utils::replace(substituted_line, unsubstituted_variable,
+                                                             env_var_dictionary[variable_name]);
+                }
+
+                // update line
+                line = match_result.suffix().str();
+            }
+
+            return substituted_line;
+        }
+    }
+
+    /*
+     * Read one specific template file and perform configuration generation.
+     * deviation: template and generated file are strings instead of files, and parameters are arguments.
+     */
+    std::string generate_file(const std::string &template_source, const std::string &definer, bool is_case_sensitive,
+                              std::unordered_map<std::string, std::string> &env_var_dictionary) {
+
+        std::ostringstream generated_file_stream;
+
+        std::istringstream template_file(template_source);
+
+        std::string line;
+        int line_count = 1;
+
+        /*
+         * To support nested if statements, stack is introduced.
+         * When we enter if statement, the evaluation is pushed on stack.
+         * If we enter another if statement, the evaluation is again pushed on stack.
+         * When we reach endif, value is popped and next evaluation is taken for previous if statement (if it exists)
+         */
+        std::stack<bool> if_statement_evaluations_stack;
+
+        while (std::getline(template_file, line)) {
+
+            std::string trimmed_line = string_utils::trim(line);
+
+            // ignore empty lines
+            if (trimmed_line.length() == 0) {
+                generated_file_stream << std::endl;
+                continue;
+            }
+
+            try {
+
+                // first, substitute everything in the file
+                // this will also substitute variables in if statements
+                // this line is not trimmed, so that indents are kept
+                std::string substituted_line = parsing_utils::substitute_vars(line, definer, env_var_dictionary);
+
+                // trim this line now, to use it for further analysis
+                std::string substituted_line_trimmed = string_utils::trim(substituted_line);
+
+                if (parsing_utils::is_line_if_statement(substituted_line_trimmed, definer)) {
+                    // is line if?
+
+                    // evaluate it
+                    bool if_statement_evaluated = parsing_utils::evaluate_if_statement_line(substituted_line_trimmed,
+                                                                                            definer,
+                                                                                            is_case_sensitive);
+
+                    // put it on stack
+                    if_statement_evaluations_stack.push(if_statement_evaluated);
+
+                } else if (parsing_utils::is_line_endif_statement(substituted_line_trimmed, definer)) {
+                    // is line endif?
+
+                    // if no other if statements have been introduced prior, this is an error
+                    if (if_statement_evaluations_stack.empty()) {
+
+                        throw std::runtime_error("No endif expected here.");
+                    }
+
+                    // take away the current if value, because the block has ended here
+                    if_statement_evaluations_stack.pop();
+
+                } else {
+                    // is normal line?
+
+                    // check if there is currently an if statement active
+                    if (!if_statement_evaluations_stack.empty()) {
+
+                        // check if currently activated if statement is evaluated as true
+                        if (if_statement_evaluations_stack.top()) {
+
+                            // if yes, add it to file. Otherwise don't.
+                            generated_file_stream << substituted_line << std::endl;
+                        }
+                    } else {
+
+                        // no if statement, add normally to the file
+                        generated_file_stream << substituted_line << std::endl;
+                    }
+                }
+
+                line_count++;
+            }
+            catch (std::runtime_error &error) {
+                std::ostringstream error_stream;
+                // deviation: there is no file path, and messages have no [ERROR] tag
+                error_stream << "Line: " << line_count << ": " << error.what();
+                throw std::runtime_error(error_stream.str());
+            }
+        }
+
+        if (!if_statement_evaluations_stack.empty()) {
+            throw std::runtime_error("Expected endif (check if every if statement has a corresponding endif)");
+        }
+
+        return generated_file_stream.str();
+    }
+}
+
+namespace {
+
+    const std::vector<std::string> DEFINERS = {"%", "#", "$", "@", "!!"};
+
+    const int PARTIAL_COUNT = 6;
+    const int TEMPLATES_PER_RUN = 150;
+
+    // each template is rendered this many times by the renderer, so that its throughput isn't only noise
+    const int RENDER_ROUNDS = 5;
+
+    const std::string BASELINE_HEADER = "config-generator engine baseline 1";
+
+    // run fails if renderer is slower than this part of baseline throughput, so by more than 20%;
+    // throughput of runs on the same idle machine differs by up to about 15%
+    const double BASELINE_TOLERANCE = 0.8;
+
+    // values never contain definers, so that substituted text can't become a variable or a statement
+    const std::vector<std::string> VALUES = {"prod", "Prod", "PROD", "dev", "Dev", "eu", "EU", "us", "80", "3000",
+                                             "a-b", "x.y", "10.0.0.1"};
+    const std::vector<std::string> WORDS = {"server", "listen", "x;", "{}", "a=b", "include", "IF", "ENDIF",
+                                            "# comment", "--flag", "[]"};
+    const std::vector<std::string> INDENTS = {"", "", "  ", "    ", "\t"};
+
+    const std::vector<std::string> SCALAR_VARIABLES = {"A", "B", "C", "D", "E", "DERIVED", "PREFIXED", "ALIAS"};
+    const std::vector<std::string> LIST_VARIABLES = {"HOSTS", "NONE", "ONE", "DERIVED_LIST"};
+
+    /*
+     * Part of generated line: text, or variable, which is bound to loop item when template is expanded.
+     */
+    struct line_part {
+        std::string text;
+        bool is_variable;
+    };
+
+    typedef std::vector<line_part> generated_line;
+
+    /*
+     * Generated line, if statement, for statement or include, with lines inside of it.
+     */
+    struct generated_node {
+        enum node_kind {
+            LINE,
+            IF,
+            FOR,
+            INCLUDE
+        } kind = LINE;
+
+        // line itself, or line that starts if, for or include statement
+        generated_line line;
+        std::string indent;
+
+        std::string loop_variable;
+        std::string list_variable;
+        int partial = 0;
+
+        // if statement without endif, to check that both renderers fail
+        bool is_closed = true;
+
+        std::vector<generated_node> children;
+    };
+
+    /*
+     * Generated template: its text, and the same template with loops and includes expanded for the baseline.
+     */
+    struct generated_template {
+        std::string source;
+        std::string expanded_source;
+    };
+
+    /*
+     * Random templates, partials and environment for one definer and case sensitivity.
+     */
+    class template_generator {
+
+    private:
+        std::mt19937 &random;
+        std::string definer;
+        bool is_case_sensitive;
+
+        // raw values with references, and values substituted for the baseline
+        std::vector<std::pair<std::string, std::string>> definitions;
+        std::unordered_map<std::string, std::string> values;
+        std::unordered_map<std::string, std::vector<std::string>> lists;
+
+        std::vector<std::vector<generated_node>> partials;
+
+        int number(int min, int max) {
+            return std::uniform_int_distribution<int>(min, max)(this->random);
+        }
+
+        bool chance(double probability) {
+            return std::uniform_real_distribution<double>(0, 1)(this->random) < probability;
+        }
+
+        const std::string &pick(const std::vector<std::string> &choices) {
+            return choices[this->number(0, (int) choices.size() - 1)];
+        }
+
+        std::string variable(const std::string &name) const {
+            return this->definer + "{" + name + "}";
+        }
+
+        void define(const std::string &name, const std::string &value, const std::string &substituted_value) {
+            this->definitions.emplace_back(name, value);
+            this->values[name] = substituted_value;
+        }
+
+        void define_list(const std::string &name, const std::vector<std::string> &items, const std::string &value) {
+            this->definitions.emplace_back(name, value);
+            this->lists[name] = items;
+        }
+
+        const std::string &pick_variable(const std::vector<std::string> &loop_variables) {
+            return loop_variables.empty() || this->chance(0.5) ? this->pick(SCALAR_VARIABLES)
+                                                               : this->pick(loop_variables);
+        }
+
+        generated_line operand(const std::vector<std::string> &loop_variables) {
+
+            int kind = this->number(0, 9);
+
+            if (kind < 4) return {{this->pick_variable(loop_variables), true}};
+            if (kind < 8) return {{this->pick(VALUES), false}};
+            if (kind < 9) return {{"x", false}, {this->pick_variable(loop_variables), true}};
+
+            return {{this->pick_variable(loop_variables), true}, {"-b", false}};
+        }
+
+        generated_line condition(const std::string &indent, const std::vector<std::string> &loop_variables) {
+
+            generated_line line = {{indent + this->definer + "IF", false}};
+            int subcondition_count = this->number(1, 3);
+
+            for (int i = 0; i < subcondition_count; i++) {
+
+                if (i > 0) {
+                    line.push_back({this->chance(0.5) ? " AND" : " OR", false});
+                }
+
+                line.push_back({" ", false});
+
+                generated_line left = this->operand(loop_variables);
+                line.insert(line.end(), left.begin(), left.end());
+
+                // operator and right side that come from one value, such as IS b
+                if (this->chance(0.05)) {
+                    line.push_back({" ", false});
+                    line.push_back({"SPACED", true});
+                    continue;
+                }
+
+                line.push_back({this->chance(0.5) ? " IS " : " IS_NOT ", false});
+
+                generated_line right = this->operand(loop_variables);
+                line.insert(line.end(), right.begin(), right.end());
+            }
+
+            return line;
+        }
+
+        generated_line text(const std::string &indent, const std::vector<std::string> &loop_variables) {
+
+            generated_line line = {{indent, false}};
+            int word_count = this->number(1, 6);
+
+            for (int i = 0; i < word_count; i++) {
+
+                if (i > 0) {
+                    line.push_back({" ", false});
+                }
+
+                int kind = this->number(0, 9);
+
+                if (kind < 4) {
+                    line.push_back({this->pick(WORDS), false});
+                } else if (kind < 7) {
+                    line.push_back({this->pick_variable(loop_variables), true});
+                } else if (kind < 8) {
+                    line.push_back({this->pick_variable(loop_variables), true});
+                    line.push_back({this->pick_variable(loop_variables), true});
+                } else if (kind < 9) {
+                    line.push_back({"SENTENCE", true});
+                } else {
+                    line.push_back({this->definer, false});
+                }
+            }
+
+            if (this->chance(0.1)) {
+                line.push_back({" ", false});
+            }
+
+            return line;
+        }
+
+        /*
+         * Lines that every renderer has to fail on. They are only put at the top of templates, outside of loops and
+         * partials, since renderer compiles loops and partials that render nothing, and baseline never sees them.
+         */
+        generated_line error_line() {
+
+            switch (this->number(0, 7)) {
+                case 0:
+                    return {{"undefined ", false}, {"UNDEFINED", true}};
+                case 1:
+                    return {{"empty ", false}, {"", true}};
+                case 2:
+                    return {{this->definer + "ENDIF", false}};
+                case 3:
+                    return {{this->definer + "ENDIF extra", false}};
+                case 4:
+                    return {{this->definer + "IF a IS", false}};
+                case 5:
+                    return {{this->definer + "IF a ISNT a", false}};
+                case 6:
+                    return {{this->definer + "IF a IS a XOR b IS b", false}};
+                default:
+                    return {{"text " + this->definer + "IF a IS a", false}};
+            }
+        }
+
+        /*
+         * Generate line_count lines (not counting lines inside of statements).
+         * Loops are kept short and shallow, since baseline renders them expanded, which is slow.
+         */
+        std::vector<generated_node> nodes(int line_count, int depth, std::vector<std::string> &loop_variables,
+                                          const std::string &loop_prefix, int partial_count,
+                                          const std::string &include_prefix) {
+
+            std::vector<generated_node> generated;
+
+            for (int i = 0; i < line_count; i++) {
+
+                generated_node node;
+                node.indent = this->pick(INDENTS);
+
+                int kind = this->number(0, 99);
+
+                if (depth < 3 && kind < 15) {
+
+                    node.kind = generated_node::IF;
+                    node.line = this->condition(node.indent, loop_variables);
+                    node.children = this->nodes(this->number(0, 5), depth + 1, loop_variables, loop_prefix,
+                                                partial_count, include_prefix);
+
+                } else if (depth < 2 && kind < 22) {
+
+                    node.kind = generated_node::FOR;
+                    node.loop_variable = loop_prefix + std::to_string(loop_variables.size());
+                    node.list_variable = this->pick(LIST_VARIABLES);
+                    node.line = {{node.indent + this->definer + "FOR " + node.loop_variable + " IN ", false},
+                                 {node.list_variable, true}};
+
+                    loop_variables.push_back(node.loop_variable);
+                    node.children = this->nodes(this->number(1, 4), depth + 1, loop_variables, loop_prefix,
+                                                partial_count, include_prefix);
+                    loop_variables.pop_back();
+
+                } else if (partial_count > 0 && kind < 27) {
+
+                    node.kind = generated_node::INCLUDE;
+                    node.partial = this->number(0, partial_count - 1);
+                    node.line = {{node.indent + this->definer + "INCLUDE " + include_prefix + "p" +
+                                  std::to_string(node.partial) + ".tpl", false}};
+
+                } else if (kind < 33) {
+                    node.line = {{this->pick({"", "   ", "\t"}), false}};
+                } else {
+                    node.line = this->text(node.indent, loop_variables);
+                }
+
+                generated.push_back(std::move(node));
+            }
+
+            return generated;
+        }
+
+        /*
+         * Text of line, with variables bound to loop items replaced by the innermost item, as renderer binds them.
+         */
+        std::string line_text(const generated_line &line,
+                              const std::vector<std::pair<std::string, std::string>> &bindings) const {
+
+            std::string text;
+
+            for (const auto &part : line) {
+
+                if (!part.is_variable) {
+                    text += part.text;
+                    continue;
+                }
+
+                auto binding = std::find_if(bindings.rbegin(), bindings.rend(),
+                                            [&](const std::pair<std::string, std::string> &bound) {
+                                                return bound.first == part.text;
+                                            });
+
+                if (binding != bindings.rend()) {
+                    text += binding->second;
+                    continue;
+                }
+
+                text += this->variable(part.text);
+            }
+
+            return text;
+        }
+
+        /*
+         * Lines of template as it is written.
+         */
+        void write_lines(const std::vector<generated_node> &nodes, std::vector<std::string> &lines) const {
+
+            for (const auto &node : nodes) {
+
+                lines.push_back(this->line_text(node.line, {}));
+
+                if (node.kind == generated_node::IF || node.kind == generated_node::FOR) {
+
+                    this->write_lines(node.children, lines);
+
+                    if (node.is_closed) {
+                        lines.push_back(node.indent + this->definer +
+                                        (node.kind == generated_node::IF ? "ENDIF" : "ENDFOR"));
+                    }
+                }
+            }
+        }
+
+        /*
+         * Lines of template with loop bodies repeated for every item and includes replaced by partials,
+         * which is what the baseline renders.
+         * Loops and includes in if statements that aren't written are left out, since they aren't rendered.
+         * Whether a line is written is decided the way baseline does it, from the innermost if statement only.
+         */
+        void expand_lines(const std::vector<generated_node> &nodes,
+                          std::vector<std::pair<std::string, std::string>> &bindings,
+                          std::vector<bool> &if_statement_evaluations, std::vector<std::string> &lines) {
+
+            for (const auto &node : nodes) {
+
+                bool is_written = if_statement_evaluations.empty() || if_statement_evaluations.back();
+
+                if (node.kind == generated_node::FOR) {
+
+                    if (!is_written) continue;
+
+                    for (const auto &item : this->lists.at(node.list_variable)) {
+                        bindings.emplace_back(node.loop_variable, item);
+                        this->expand_lines(node.children, bindings, if_statement_evaluations, lines);
+                        bindings.pop_back();
+                    }
+
+                } else if (node.kind == generated_node::INCLUDE) {
+
+                    if (!is_written) continue;
+
+                    this->expand_lines(this->partials[node.partial], bindings, if_statement_evaluations, lines);
+
+                } else if (node.kind == generated_node::IF) {
+
+                    std::string condition = this->line_text(node.line, bindings);
+                    lines.push_back(condition);
+
+                    condition = baseline::string_utils::trim(
+                            baseline::parsing_utils::substitute_vars(condition, this->definer, this->values));
+                    if_statement_evaluations.push_back(baseline::parsing_utils::evaluate_if_statement_line(
+                            condition, this->definer, this->is_case_sensitive));
+
+                    this->expand_lines(node.children, bindings, if_statement_evaluations, lines);
+
+                    // if statement without endif stays open for the rest of template, as it does when rendered
+                    if (node.is_closed) {
+                        lines.push_back(node.indent + this->definer + "ENDIF");
+                        if_statement_evaluations.pop_back();
+                    }
+
+                } else {
+                    lines.push_back(this->line_text(node.line, bindings));
+                }
+            }
+        }
+
+        static std::string join_lines(const std::vector<std::string> &lines, bool has_last_newline) {
+
+            std::string text;
+
+            for (size_t i = 0; i < lines.size(); i++) {
+                if (i > 0) text += '\n';
+                text += lines[i];
+            }
+
+            // last line that is empty would be lost without newline, but it is still there when partial is expanded
+            if (!lines.empty() && (has_last_newline || lines.back().empty())) {
+                text += '\n';
+            }
+
+            return text;
+        }
+
+    public:
+        template_generator(std::mt19937 &random, std::string definer, bool is_case_sensitive)
+                : random(random), definer(std::move(definer)), is_case_sensitive(is_case_sensitive) {}
+
+        /*
+         * Define environment with scalar values, derived values and lists.
+         */
+        void generate_environment() {
+
+            for (const char *name : {"A", "B", "C", "D", "E"}) {
+                const std::string &value = this->pick(VALUES);
+                this->define(name, value, value);
+            }
+
+            this->define("DERIVED", this->variable("A") + "-" + this->variable("B"),
+                         this->values["A"] + "-" + this->values["B"]);
+            this->define("PREFIXED", "pre." + this->variable("DERIVED"), "pre." + this->values["DERIVED"]);
+            this->define("ALIAS", this->variable("C"), this->values["C"]);
+
+            std::string operation = this->chance(0.5) ? "IS" : "IS_NOT";
+            const std::string &operand = this->pick(VALUES);
+            this->define("SPACED", operation + " " + operand, operation + " " + operand);
+            this->define("SENTENCE", "two words", "two words");
+
+            std::vector<std::string> hosts;
+            std::string hosts_value = "[";
+
+            for (int i = this->number(2, 4); i > 0; i--) {
+                hosts.push_back(this->pick(VALUES));
+                hosts_value += (hosts.size() > 1 ? this->pick({",", ", ", " , "}) : "") + hosts.back();
+            }
+
+            this->define_list("HOSTS", hosts, hosts_value + "]");
+            this->define_list("NONE", {}, "[]");
+
+            const std::string &item = this->pick(VALUES);
+            this->define_list("ONE", {item}, "[" + item + "]");
+            this->define_list("DERIVED_LIST", {this->values["A"], this->values["E"]},
+                              "[" + this->variable("A") + ", " + this->variable("E") + "]");
+        }
+
+        /*
+         * Generate partials, which can include partials before them, and write them into directory.
+         */
+        void generate_partials(const std::string &directory) {
+
+            this->partials.clear();
+
+            for (int i = 0; i < PARTIAL_COUNT; i++) {
+
+                std::vector<std::string> loop_variables;
+                this->partials.push_back(this->nodes(this->number(1, 4), 0, loop_variables, "each", i, ""));
+
+                std::vector<std::string> lines;
+                this->write_lines(this->partials.back(), lines);
+
+                std::ofstream(directory + "/p" + std::to_string(i) + ".tpl")
+                        << join_lines(lines, this->chance(0.8));
+            }
+        }
+
+        generated_template generate_template() {
+
+            std::vector<std::string> loop_variables;
+            std::vector<generated_node> nodes = this->nodes(this->number(5, 40), 0, loop_variables, "item",
+                                                            PARTIAL_COUNT, "partials/");
+
+            // errors only at the top of template, see error_line
+            if (this->chance(0.2)) {
+
+                size_t position = this->number(0, (int) nodes.size() - 1);
+
+                if (nodes[position].kind == generated_node::IF && this->chance(0.3)) {
+                    nodes[position].is_closed = false;
+                } else {
+                    generated_node error;
+                    error.line = this->error_line();
+                    nodes.insert(nodes.begin() + position, error);
+                }
+            }
+
+            std::vector<std::string> lines, expanded_lines;
+            std::vector<std::pair<std::string, std::string>> bindings;
+            std::vector<bool> if_statement_evaluations;
+
+            this->write_lines(nodes, lines);
+            this->expand_lines(nodes, bindings, if_statement_evaluations, expanded_lines);
+
+            bool has_last_newline = this->chance(0.8);
+
+            return {join_lines(lines, has_last_newline), join_lines(expanded_lines, has_last_newline)};
+        }
+
+        void define_environment(env_dictionary &dictionary) const {
+
+            for (const auto &definition : this->definitions) {
+                dictionary.define(definition.first, env_value(definition.second), "test.env", 1);
+            }
+        }
+
+        std::unordered_map<std::string, std::string> &substituted_values() {
+            return this->values;
+        }
+    };
+
+    /*
+     * Results of one engine over all runs, and time spent rendering.
+     */
+    struct engine_run {
+        std::chrono::steady_clock::duration time{};
+        unsigned long rendered_count = 0;
+        unsigned long rendered_size = 0;
+
+        void add(std::chrono::steady_clock::duration render_time, size_t template_size) {
+            this->time += render_time;
+            this->rendered_count++;
+            this->rendered_size += template_size;
+        }
+
+        double seconds() const {
+            return std::max(std::chrono::duration<double>(this->time).count(), 1e-9);
+        }
+
+        double megabytes_per_second() const {
+            return std::round(this->rendered_size / 1e6 / this->seconds() * 10) / 10;
+        }
+
+        double files_per_second() const {
+            return std::round(this->rendered_count / this->seconds() * 10) / 10;
+        }
+    };
+
+    /*
+     * Everything that differs between the two renders of generated template.
+     */
+    struct difference_report {
+        int reported_count = 0;
+        unsigned long differing_count = 0;
+        unsigned long failing_count = 0;
+    };
+
+    void report_difference(difference_report &report, const std::string &description,
+                           const generated_template &generated, const std::string &rendered,
+                           const std::string &baseline_rendered) {
+
+        report.differing_count++;
+
+        // the first few are enough to find the cause
+        if (report.reported_count++ >= 3) return;
+
+        std::cerr << "Renderers differ: " << description << "\n--- template:\n" << generated.source
+                  << "\n--- expanded for baseline:\n" << generated.expanded_source << "\n--- renderer:\n" << rendered
+                  << "\n--- baseline:\n" << baseline_rendered << "\n---" << std::endl;
+    }
+
+    /*
+     * Generate templates for definer and case sensitivity, render them with both renderers and compare outputs.
+     */
+    void compare_renderers(std::mt19937 &random, const std::string &definer, bool is_case_sensitive,
+                           const std::string &directory, engine_run &renderer_run, engine_run &baseline_run,
+                           difference_report &report) {
+
+        template_generator generator(random, definer, is_case_sensitive);
+        generator.generate_environment();
+        generator.generate_partials(directory + "/partials");
+
+        env_dictionary dictionary(definer);
+        generator.define_environment(dictionary);
+
+        for (const auto &error : dictionary.link()) {
+            std::cerr << error << std::endl;
+            report.differing_count++;
+        }
+
+        partial_cache partials(definer);
+        template_renderer renderer(definer, is_case_sensitive, dictionary, partials);
+        output_buffer output;
+
+        std::string file_path = directory + "/template.tpl";
+
+        for (int i = 0; i < TEMPLATES_PER_RUN; i++) {
+
+            generated_template generated = generator.generate_template();
+
+            std::string rendered, baseline_rendered;
+            bool is_failed = false, is_baseline_failed = false;
+
+            for (int round = 0; round < RENDER_ROUNDS; round++) {
+
+                auto start = std::chrono::steady_clock::now();
+
+                try {
+                    renderer.render(generated.source, file_path, output);
+                }
+                catch (std::runtime_error &error) {
+                    is_failed = true;
+                    rendered = error.what();
+                }
+
+                renderer_run.add(std::chrono::steady_clock::now() - start, generated.source.size());
+            }
+
+            auto baseline_start = std::chrono::steady_clock::now();
+
+            try {
+                baseline_rendered = baseline::generate_file(generated.expanded_source, definer, is_case_sensitive,
+                                                            generator.substituted_values());
+            }
+            catch (std::runtime_error &error) {
+                is_baseline_failed = true;
+                baseline_rendered = error.what();
+            }
+
+            baseline_run.add(std::chrono::steady_clock::now() - baseline_start, generated.source.size());
+
+            if (!is_failed) {
+                rendered = std::string(output.view());
+            }
+
+            std::ostringstream description;
+            description << "definer " << definer << ", " << (is_case_sensitive ? "case sensitive" : "case insensitive")
+                        << ", template " << i;
+
+            // error messages differ, since baseline doesn't know where expanded lines came from
+            if (is_failed != is_baseline_failed) {
+                description << ", only " << (is_failed ? "renderer" : "baseline") << " fails";
+                report_difference(report, description.str(), generated, rendered, baseline_rendered);
+            } else if (is_failed) {
+                report.failing_count++;
+            } else if (rendered != baseline_rendered) {
+                report_difference(report, description.str(), generated, rendered, baseline_rendered);
+            }
+        }
+    }
+
+    void save_baseline(const std::string &baseline_file_path, const engine_run &renderer_run) {
+
+        std::ofstream baseline_file(baseline_file_path);
+        baseline_file << BASELINE_HEADER << '\n' << "compiled\t" << renderer_run.megabytes_per_second() << '\t'
+                      << renderer_run.files_per_second() << '\n';
+
+        if (!baseline_file.good()) {
+            std::ostringstream error_stream;
+            error_stream << "Can't write baseline " << baseline_file_path << ".";
+            throw std::runtime_error(error_stream.str());
+        }
+    }
+
+    /*
+     * Returns false if renderer is noticeably slower than baseline.
+     * Throws runtime_error if baseline can't be read.
+     */
+    bool compare_baseline(const std::string &baseline_file_path, const engine_run &renderer_run) {
+
+        std::ifstream baseline_file(baseline_file_path);
+
+        std::string header, kind;
+        double baseline_megabytes_per_second = 0, baseline_files_per_second = 0;
+
+        std::getline(baseline_file, header);
+        baseline_file >> kind >> baseline_megabytes_per_second >> baseline_files_per_second;
+
+        if (header != BASELINE_HEADER || kind != "compiled" || baseline_file.fail()) {
+            std::ostringstream error_stream;
+            error_stream << "Baseline " << baseline_file_path << " doesn't exist or isn't valid.";
+            throw std::runtime_error(error_stream.str());
+        }
+
+        if (renderer_run.megabytes_per_second() < baseline_megabytes_per_second * BASELINE_TOLERANCE ||
+            renderer_run.files_per_second() < baseline_files_per_second * BASELINE_TOLERANCE) {
+            std::cerr << "Renderer is slower than baseline " << baseline_file_path << ": "
+                      << renderer_run.megabytes_per_second() << " MB/s and " << renderer_run.files_per_second()
+                      << " files/s, baseline " << baseline_megabytes_per_second << " MB/s and "
+                      << baseline_files_per_second << " files/s." << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+}
+
+/*
+ * Renders randomized templates with template_renderer and with the baseline line by line renderer, for every definer
+ * and both case modes, and checks that outputs are byte identical, or that both fail.
+ * Usage: engine-differential-test [--seed N] [--baseline FILE] [--save-baseline FILE]
+ * With --baseline, fails if renderer throughput is lower than BASELINE_TOLERANCE of throughput saved in FILE.
+ * If FILE doesn't exist yet, this run's throughput is saved to it, the same way as with --save-baseline.
+ */
+int main(int argc, char **argv) {
+
+    unsigned long seed = 1;
+    std::string baseline_file_path, saved_baseline_file_path;
+
+    for (int i = 1; i < argc; i += 2) {
+
+        std::string argument = argv[i];
+
+        if (i + 1 == argc) {
+            std::cerr << "Option " << argument << " needs a value." << std::endl;
+            return 1;
+        } else if (argument == "--seed") {
+            seed = std::strtoul(argv[i + 1], nullptr, 10);
+        } else if (argument == "--baseline") {
+            baseline_file_path = argv[i + 1];
+        } else if (argument == "--save-baseline") {
+            saved_baseline_file_path = argv[i + 1];
+        } else {
+            std::cerr << "Unknown option " << argument << "." << std::endl;
+            return 1;
+        }
+    }
+
+    char directory[] = "/tmp/engine-differential-XXXXXX";
+
+    if (mkdtemp(directory) == nullptr) {
+        std::cerr << "Can't create temporary directory." << std::endl;
+        return 1;
+    }
+
+    std::string partials_directory = std::string(directory) + "/partials";
+    mkdir(partials_directory.c_str(), 0777);
+
+    std::mt19937 random(seed);
+    engine_run renderer_run, baseline_run;
+    difference_report report;
+    bool is_fast_enough = true;
+
+    try {
+        for (const auto &definer : DEFINERS) {
+            compare_renderers(random, definer, false, directory, renderer_run, baseline_run, report);
+            compare_renderers(random, definer, true, directory, renderer_run, baseline_run, report);
+        }
+
+        std::cout << "Compared " << baseline_run.rendered_count << " templates (seed " << seed << "), "
+                  << report.failing_count << " fail in both, " << report.differing_count << " differ." << std::endl
+                  << "Renderer: " << renderer_run.megabytes_per_second() << " MB/s, "
+                  << renderer_run.files_per_second() << " files/s. Baseline: "
+                  << baseline_run.megabytes_per_second() << " MB/s, " << baseline_run.files_per_second()
+                  << " files/s." << std::endl;
+
+        if (!baseline_file_path.empty() && access(baseline_file_path.c_str(), F_OK) != 0) {
+            save_baseline(baseline_file_path, renderer_run);
+            std::cout << "Saved baseline " << baseline_file_path << "." << std::endl;
+        } else if (!baseline_file_path.empty()) {
+            is_fast_enough = compare_baseline(baseline_file_path, renderer_run);
+        }
+
+        if (!saved_baseline_file_path.empty()) {
+            save_baseline(saved_baseline_file_path, renderer_run);
+        }
+    }
+    catch (std::runtime_error &error) {
+        std::cerr << error.what() << std::endl;
+        report.differing_count++;
+    }
+
+    for (int i = 0; i < PARTIAL_COUNT; i++) {
+        std::remove((partials_directory + "/p" + std::to_string(i) + ".tpl").c_str());
+    }
+
+    rmdir(partials_directory.c_str());
+    rmdir(directory);
+
+    return report.differing_count == 0 && is_fast_enough ? 0 : 1;
+}
@@ -0,0 +1,132 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "../src/generator_parameters.h"
+#include "../src/config_generator.h"
+
+namespace {
+
+    /*
+     * Environment files, in the order they are given, and what %{UP} %{HOST} renders to with them.
+     */
+    struct override_case {
+        std::string name;
+        std::vector<std::string> env_files;
+        std::string expected_output;
+    };
+
+    /*
+     * Derived values that are overridden, by the same file or by a later one, before they are linked.
+     */
+    std::vector<override_case> override_cases() {
+        return {
+                {"same file",          {"UP=%{HOST}\nUP=fixed\nHOST=h\n"},                "fixed h\n"},
+                {"later file",         {"UP=%{HOST}:1\n",           "UP=x\nHOST=h\n"},    "x h\n"},
+                {"cycle overridden",   {"UP=%{HOST}\nHOST=%{UP}\n", "UP=u\nHOST=h\n"},    "u h\n"},
+                {"reference in later", {"UP=%{HOST}:1\n",           "HOST=h\n"},          "h:1 h\n"},
+                {"derived override",   {"UP=x\nHOST=h\n",           "UP=%{HOST}:2\n"},    "h:2 h\n"},
+        };
+    }
+
+    std::string read_text(const std::string &file_path) {
+        std::ifstream file(file_path);
+        std::ostringstream text;
+        text << file.rdbuf();
+        return text.str();
+    }
+
+    /*
+     * Render template with environment files of override case, the same way as config-generator does.
+     * Returns false if output isn't the expected one.
+     */
+    bool check_override(const override_case &tested, const std::string &directory) {
+
+        std::string template_path = directory + "/template.tpl";
+        std::string output_path = directory + "/output";
+
+        std::ofstream(template_path) << "%{UP} %{HOST}\n";
+
+        std::vector<std::string> arguments = {"config-generator", "--quiet", "--file", template_path,
+                                              "--out", output_path};
+
+        for (size_t i = 0; i < tested.env_files.size(); i++) {
+
+            std::string env_path = directory + "/" + std::to_string(i) + ".env";
+            std::ofstream(env_path) << tested.env_files[i];
+
+            arguments.emplace_back("--env");
+            arguments.push_back(env_path);
+        }
+
+        std::vector<char *> argv;
+
+        for (auto &argument : arguments) {
+            argv.push_back(&argument[0]);
+        }
+
+        argv.push_back(nullptr);
+
+        bool is_rendered;
+
+        {
+            generator_parameters parameters;
+
+            // getopt keeps its position between calls
+            optind = 0;
+
+            is_rendered = parameters.configure((int) arguments.size(), argv.data()) &&
+                          config_generator(parameters).run();
+        }
+
+        std::string output = read_text(output_path);
+
+        for (size_t i = 0; i < tested.env_files.size(); i++) {
+            std::remove((directory + "/" + std::to_string(i) + ".env").c_str());
+        }
+
+        std::remove(template_path.c_str());
+        std::remove(output_path.c_str());
+
+        if (!is_rendered || output != tested.expected_output) {
+            std::cerr << "Override '" << tested.name << "' rendered '" << output << "', expected '"
+                      << tested.expected_output << "'." << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+}
+
+/*
+ * Checks that overriding derived values, which happens before they can be evaluated, takes the last value.
+ */
+int main() {
+
+    char directory[] = "/tmp/env-override-XXXXXX";
+
+    if (mkdtemp(directory) == nullptr) {
+        std::cerr << "Can't create temporary directory." << std::endl;
+        return 1;
+    }
+
+    int failed_count = 0;
+
+    for (const auto &tested : override_cases()) {
+        if (!check_override(tested, directory)) {
+            failed_count++;
+        }
+    }
+
+    rmdir(directory);
+
+    if (failed_count > 0) {
+        return 1;
+    }
+
+    std::cout << "Overridden derived values take the last value." << std::endl;
+    return 0;
+}
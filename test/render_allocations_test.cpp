@@ -0,0 +1,179 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "../src/template_renderer.h"
+#include "../src/output_buffer.h"
+#include "../src/partial_cache.h"
+#include "../src/env_dictionary.h"
+
+/*
+ * Counts every allocation of the process, so that the steady state of rendering can be checked
+ * to allocate nothing at all.
+ */
+static std::atomic<unsigned long> allocation_count(0);
+
+void *operator new(size_t size) {
+
+    allocation_count++;
+
+    void *memory = std::malloc(size == 0 ? 1 : size);
+
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+
+    return memory;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept {
+    std::free(memory);
+}
+
+namespace {
+
+    const int WARM_UP_RENDERS = 3;
+    const int COUNTED_RENDERS = 50;
+
+    struct test_template {
+        std::string name;
+        std::string source;
+    };
+
+    /*
+     * Templates that cover every kind of line: text, nested if statements, compiled and substituted conditions,
+     * includes, loops, loops with if statements and includes inside of them, and derived values.
+     */
+    std::vector<test_template> test_templates(const std::string &directory) {
+        return {
+                {"text",        "server %{HOST}:%{PORT};\n  plain line\n\n   \nlast %{HOST}%{PORT}"},
+                {"if",          "%IF %{MODE} IS prod\nprod %{HOST}\n  %IF %{PORT} IS_NOT 80 OR %{MODE} IS dev\n"
+                                "  port %{PORT}\n  %ENDIF\n%ENDIF\n%IF x%{MODE} IS xprod\nsubstituted\n%ENDIF\n"},
+                {"spaces",      "%IF a %{SPACED} AND c IS c\nspaced\n%ENDIF\n"},
+                {"derived",     "upstream %{UPSTREAM}\n"},
+                {"include",     "before\n%INCLUDE " + directory + "/partial.tpl\nafter\n"},
+                {"for",         "%FOR backend IN %{BACKENDS}\n    server %{backend};\n%ENDFOR\n"},
+                {"nested for",  "%FOR zone IN %{ZONES}\n%FOR backend IN %{BACKENDS}\n%IF %{zone} IS eu\n"
+                                "%{zone}/%{backend}\n%ENDIF\n%ENDFOR\n%ENDFOR\n"},
+                {"for include", "%FOR zone IN %{ZONES}\n%INCLUDE " + directory + "/zone.tpl\n%ENDFOR\n"},
+                {"empty for",   "%FOR zone IN %{EMPTY}\nnever\n%ENDFOR\n"},
+        };
+    }
+
+    void define(env_dictionary &dictionary, const std::string &name, const std::string &value) {
+        dictionary.define(name, env_value(value), "test.env", 1);
+    }
+
+    /*
+     * Render every template until buffers have grown, then count allocations of further renders.
+     * Returns number of templates that still allocate.
+     */
+    int check_allocations(bool is_case_sensitive, const std::string &directory) {
+
+        env_dictionary dictionary("%");
+
+        define(dictionary, "HOST", "example.com");
+        define(dictionary, "PORT", "8080");
+        define(dictionary, "MODE", "prod");
+        define(dictionary, "SPACED", "IS b");
+        define(dictionary, "UPSTREAM", "%{HOST}:%{PORT}");
+        define(dictionary, "BACKENDS", "[10.0.0.1:80, 10.0.0.2:80, 10.0.0.3:8080]");
+        define(dictionary, "ZONES", "[eu, us]");
+        define(dictionary, "EMPTY", "[]");
+        dictionary.link();
+
+        partial_cache partials("%");
+        template_renderer renderer("%", is_case_sensitive, dictionary, partials);
+        output_buffer output;
+
+        int failed_count = 0;
+
+        for (const auto &tested : test_templates(directory)) {
+
+            std::string file_path = tested.name + ".tpl";
+
+            for (int i = 0; i < WARM_UP_RENDERS; i++) {
+                renderer.render(tested.source, file_path, output);
+            }
+
+            unsigned long allocations_before = allocation_count;
+
+            for (int i = 0; i < COUNTED_RENDERS; i++) {
+                renderer.render(tested.source, file_path, output);
+            }
+
+            unsigned long allocations = allocation_count - allocations_before;
+
+            if (allocations > 0) {
+                std::cerr << "Template '" << tested.name << "' ("
+                          << (is_case_sensitive ? "case sensitive" : "case insensitive") << ") allocated " << allocations << " times in " << COUNTED_RENDERS << " renders." << std::endl;
+                failed_count++;
+            }
+        }
+
+        return failed_count;
+    }
+}
+
+/*
+ * Checks that rendering into a reused output_buffer with a reused template_renderer doesn't allocate,
+ * once buffers have grown to the largest template.
+ */
+int main() {
+
+    char directory[] = "/tmp/render-allocations-XXXXXX";
+
+    if (mkdtemp(directory) == nullptr) {
+        std::cerr << "Can't create temporary directory." << std::endl;
+        return 1;
+    }
+
+    std::string partial_path = std::string(directory) + "/partial.tpl";
+    std::string zone_path = std::string(directory) + "/zone.tpl";
+
+    std::ofstream(partial_path) << "  partial %{HOST}\n%IF %{MODE} IS prod\n  prod\n%ENDIF\n";
+    std::ofstream(zone_path) << "%IF %{MODE} IS prod\n  zone %{zone}\n%ENDIF\n";
+
+    int failed_count = 0;
+
+    try {
+        failed_count += check_allocations(false, directory);
+        failed_count += check_allocations(true, directory);
+    }
+    catch (std::runtime_error &error) {
+        std::cerr << error.what() << std::endl;
+        failed_count++;
+    }
+
+    std::remove(partial_path.c_str());
+    std::remove(zone_path.c_str());
+    rmdir(directory);
+
+    if (failed_count > 0) {
+        return 1;
+    }
+
+    std::cout << "Rendering doesn't allocate once buffers have grown." << std::endl;
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../src/generator_parameters.h"
+#include "../src/config_generator.h"
+
+namespace {
+
+    std::string read_text(const std::string &file_path) {
+        std::ifstream file(file_path);
+        std::ostringstream text;
+        text << file.rdbuf();
+        return text.str();
+    }
+
+    /*
+     * Run config-generator with arguments in working directory, the same way as main does.
+     * Returns what it printed to stdout, or "failed" if it didn't succeed.
+     */
+    std::string run(const std::string &working_directory, std::vector<std::string> arguments) {
+
+        arguments.insert(arguments.begin(), "config-generator");
+
+        std::vector<char *> argv;
+
+        for (auto &argument : arguments) {
+            argv.push_back(&argument[0]);
+        }
+
+        argv.push_back(nullptr);
+
+        if (chdir(working_directory.c_str()) != 0) {
+            return "failed";
+        }
+
+        std::ostringstream output;
+        std::streambuf *stdout_buffer = std::cout.rdbuf(output.rdbuf());
+
+        bool is_run;
+
+        {
+            generator_parameters parameters;
+
+            // getopt keeps its position between calls
+            optind = 0;
+
+            is_run = parameters.configure((int) arguments.size(), argv.data()) && config_generator(parameters).run();
+        }
+
+        std::cout.rdbuf(stdout_buffer);
+
+        return is_run ? output.str() : "failed";
+    }
+}
+
+/*
+ * Checks that index built with relative template paths is still valid when it is queried from another
+ * working directory, and that the query doesn't change it.
+ */
+int main() {
+
+    char directory[] = "/tmp/template-index-XXXXXX";
+
+    if (mkdtemp(directory) == nullptr) {
+        std::cerr << "Can't create temporary directory." << std::endl;
+        return 1;
+    }
+
+    std::string template_directory = std::string(directory) + "/templates";
+    std::string index_path = std::string(directory) + "/templates.index";
+
+    mkdir(template_directory.c_str(), 0777);
+
+    std::ofstream(template_directory + "/host.tpl") << "server %{HOST}\n%INCLUDE port.part\n";
+    std::ofstream(template_directory + "/port.part") << "port %{PORT}\n";
+    std::ofstream(template_directory + "/mode.tpl") << "%IF %{MODE} IS prod\nprod\n%ENDIF\n";
+
+    int failed_count = 0;
+
+    std::string built = run(directory, {"--quiet", "--dir", "templates", "--index", index_path,
+                                        "--affected-by", "PORT"});
+    std::string saved_index = read_text(index_path);
+
+    if (built != "host.tpl\nport.part\n") {
+        std::cerr << "Building index printed '" << built << "'." << std::endl;
+        failed_count++;
+    }
+
+    std::string queried = run("/", {"--quiet", "--index", index_path, "--affected-by", "PORT",
+                                    "--affected-by", "MODE"});
+
+    if (queried != "host.tpl\nmode.tpl\nport.part\n") {
+        std::cerr << "Querying index from another directory printed '" << queried << "'." << std::endl;
+        failed_count++;
+    }
+
+    if (read_text(index_path) != saved_index) {
+        std::cerr << "Querying index from another directory changed it:\n" << read_text(index_path) << std::endl;
+        failed_count++;
+    }
+
+    for (const char *file_name : {"/host.tpl", "/port.part", "/mode.tpl"}) {
+        std::remove((template_directory + file_name).c_str());
+    }
+
+    std::remove(index_path.c_str());
+    rmdir(template_directory.c_str());
+    rmdir(directory);
+
+    if (failed_count > 0) {
+        return 1;
+    }
+
+    std::cout << "Template index can be queried from any working directory." << std::endl;
+    return 0;
+}